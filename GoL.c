@@ -19,39 +19,530 @@
  *              - Any dead cell with exactly three live neighbors
  *              becomes a live cell, as if by reproduction.
  *
- *           Updates take place all at once.
+ *           Updates take place all at once.  With -u other
+ *           Life-like rules can be played instead (see note 19).
  *
- * Compile:  gcc -g -Wall -o life life.c
- * Run:      ./life <r> <s> <rows> <cols> <max gens> <'i'|'g'>
- *              r = number of rows of threads
- *              s = number of columns of threads
+ * Compile:  gcc -g -Wall -o life life.c GoL_lib.c  (see note 21)
+ *           mpicc -g -Wall -DUSE_MPI -o life life.c GoL_lib.c  (see
+ *              note 10)
+ *           nvcc -O3 -c GoL_gpu.cu
+ *           gcc -g -Wall -DUSE_CUDA -o life life.c GoL_lib.c GoL_gpu.o
+ *              -lcudart  (see note 11;  with HIP, build GoL_gpu.cu with
+ *              hipcc -DUSE_HIP and link with -lamdhip64)
+ *           gcc -g -Wall -DUSE_TRACE -o life life.c GoL_lib.c  (see
+ *              note 16)
+ *           gcc -g -Wall -DUSE_LZ4 -DUSE_ZSTD -o life life.c GoL_lib.c
+ *              -llz4 -lzstd  (for -z;  either one can be left out)
+ * Run:      ./life [options] <r> <s> <rows> <cols> <max gens> <'i'|'g'>
+ *           mpiexec -n <procs> ./life [options] <r> <s> ...
+ *              r*s = number of worker threads (r and s are kept
+ *                    for compatibility;  only their product matters)
+ *                    in each process
  *              rows = number of rows in the world
  *              cols = number of cols in the world
  *              max gens = max number of generations
  *              'i' = user will enter generation 0
  *              'g' = program should generate generation 0
+ *           Options:
+ *              -o <when>  which generations to print:  all (the
+ *                         default), a number k (every k-th generation),
+ *                         final, or none
+ *              -f <fmt>   output format:  ascii (the default), packed,
+ *                         rle, or delta[,<k>] with a keyframe every k
+ *                         printed worlds (default 100, see note 23)
+ *              -z <codec> compress the delta format's frames with lz4
+ *                         or zstd
+ *              -H         put a header line with the generation and
+ *                         live count before each ascii world
+ *              -i <file>  read generation 0 from a file instead of
+ *                         stdin (implies 'i')
+ *              -p <row>,<col>  put the top left corner of the input
+ *                         pattern at (row, col) instead of (0, 0)
+ *              -S <seed>  seed for generating generation 0 (default 1)
+ *              -a         recompute every tile every generation (see
+ *                         note 7)
+ *              -b <gens>  every gens generations, reseed the
+ *                         threads' work queues using the time each
+ *                         tile took (see note 3)
+ *              -T <rows>,<words>  maximum tile size (default 32,8)
+ *              -K <gens>  compute up to gens generations between
+ *                         barriers (see note 8)
+ *              -N <policy>  where to put the world's memory:  local
+ *                         (the default), interleave, or off (see
+ *                         note 9)
+ *              -E <engine>  cpu (the default), sparse or auto (see
+ *                         note 13), hashlife (see note 12), or gpu if
+ *                         compiled with USE_CUDA (see note 11)
+ *              -U         with -E hashlife, play on an unbounded plane
+ *                         instead of the torus, and print the part of
+ *                         it where the world started.  Not with -c or
+ *                         -r (see note 17).
+ *              -m <nodes>  with -E hashlife, collect garbage when there
+ *                         are more than this many nodes (default
+ *                         4194304)
+ *              -L <pages>  what to back the worlds with:  thp (the
+ *                         default, transparent huge pages), hugetlb
+ *                         (explicit huge pages, falling back to thp),
+ *                         or off (ordinary pages)
+ *              -C <gens>  look for cycles of up to gens generations,
+ *                         and skip ahead once one is found (see note
+ *                         14).  Only with the cpu engine.
+ *              -B <fmt>[,<warmup>]  benchmark:  print nothing but the
+ *                         timings, as csv or json, after warmup
+ *                         generations (default 10) that aren't timed.
+ *                         r, rows and cols may then be lists like
+ *                         1,2,4 (see note 15)
+ *              -Q <file>  with USE_TRACE, write a timeline of what each
+ *                         thread did to file (see note 16)
+ *              -c <gens>,<file>  every gens generations, and at the
+ *                         end, save the world to the checkpoint file
+ *                         (see note 17)
+ *              -r <file>  restart from a checkpoint file instead of
+ *                         reading or generating generation 0.  rows
+ *                         and cols have to match it, and max gens
+ *                         still counts from generation 0.
+ *              -R <row>,<col>,<rows>,<cols>  only print the rows x cols
+ *                         window of the world whose top left cell is
+ *                         (row, col) (see note 18)
+ *              -D <k>     print the number of live cells in each k x k
+ *                         block of the window instead of the cells
+ *                         (ascii and packed formats only)
+ *              -u <rule>  play a rule in B/S notation, like B36/S23,
+ *                         instead of B3/S23, or one of the rules with
+ *                         kernels of their own by name (see note 19)
+ *              -M <seeds>[/<probs>]  ensemble:  play a generated world
+ *                         of rows x cols for each seed in a list like
+ *                         1-1000,2000 and each prob in a list like
+ *                         0.2,0.35, and print a summary of each
+ *                         instead of its generations.  Without probs
+ *                         the prob is asked for as with 'g', which
+ *                         the input char has to be (see note 20)
+ *              -s <file>  with the cpu engine, write the live count,
+ *                         births, deaths, bounding box of the live
+ *                         cells and a histogram of the tiles'
+ *                         densities of each generation to file (see
+ *                         note 22)
+ *              -V <file>  self-check:  play known patterns and a soup of
+ *                         rows x cols for max gens on every engine,
+ *                         check each against the library, time it, and
+ *                         compare the times with the baseline in file,
+ *                         or write file if there isn't one (see note
+ *                         24).  The input char has to be 'g'.
+ *              -A <file>  auto-tune:  choose the threads, the kernel,
+ *                         the tiles and -K by timing short runs of the
+ *                         world, instead of from r*s, -T and -K, and
+ *                         add them to the tuning file, or use the
+ *                         ones already in it for this host, world size
+ *                         and rule (see note 25)
  *
  * Input:    If command line has the "input" char ('i'), the first
  *              generation.  Each row should be entered on a separate
  *              line of input.  Live cells should be indicated with
  *              a capital 'X', and dead cells with a blank, ' '.
+ *              Short lines are padded with dead cells, a '\r' is
+ *              ignored, and lines starting with '!' are comments.
+ *           A file given with -i can also be a run length encoded
+ *              (.rle) pattern, or a plaintext (.cells) pattern in
+ *              which lines starting with '!' are comments and live
+ *              cells are 'O'.  The format is taken from the file's
+ *              suffix, or from its contents if it has neither suffix.
+ *              A pattern that runs off the edge of the world wraps
+ *              around.
  *           If command line had the "generate" char ('g'), the program will
  *              ask for the probability that a cell will be alive.
+ *              Generation 0 is then generated by the worker threads:
+ *              cell (i,j) is alive if a hash of the seed and i*n+j is
+ *              less than prob*2^64, so for a given seed the world is
+ *              the same whatever the number of threads.
  *
  * Output:   The initial world (generation 0) and the world after
  *           each subsequent generation up to and including
  *           generation = max_gen.  If all of the cells die,
- *           the program will terminate.
+ *           the program will terminate.  With -o k only generations
+ *           that are multiples of k are printed;  with -o final only
+ *           the last generation computed.  In any format but ascii
+ *           the prompts go to stderr, so stdout is only the worlds.
+ *           In the packed format each world is a Packed_header_t
+ *           followed by the m rows, each as W = ceil(n/64) native
+ *           64-bit words (see note 2).  In the rle format each world
+ *           is a standard run length encoded pattern with the
+ *           generation and live count in a #C line.  With -R, m and n
+ *           are the window's, and with -D the format changes too (see
+ *           note 18).  In the delta format each world is a frame:  a
+ *           Delta_header_t followed by its payload.  The payload of a
+ *           keyframe ("GoLK") is the world's words as in the packed
+ *           format, and that of a change frame ("GoLC") is, for each
+ *           word that differs from the last world printed, the number
+ *           of unchanged words before it since the last change, as a
+ *           LEB128 varint, and then the word XORed with the old one.
+ *           With -z the payload is compressed, unless that doesn't
+ *           make it smaller, and the header has the codec used and
+ *           the payload's size before and after.  With -M the
+ *           output is a csv line for each world of the ensemble:  its
+ *           seed and prob, the number of generations played, the live
+ *           count after them, the generation when it died (or -1),
+ *           and the period of the cycle it ended in (or 0 if none was
+ *           found).
+ *           With -V the output is a csv line for each run:  the case,
+ *           the engine and threads, the size, the generations, ok,
+ *           wrong, crashed, slow or skip, and the best time per
+ *           generation and the baseline's.  The exit status is 1 if
+ *           any run was wrong or crashed, or else 2 if any was slow
+ *           (which is only a warning, since it can be noise).
+ *           The -s file is csv with a line for each generation
+ *           computed:  gen, live, births, deaths, the top, left,
+ *           bottom and right of the box that holds the live cells (or
+ *           -1's if there are none), and then the number of tiles
+ *           that are empty, and with densities up to 10%, 20%, ...
+ *           100%.  With -B -s the benchmark also reports the final
+ *           live count and the births and deaths in the timed
+ *           generations.
  *
  * Notes:
  * 1.  This implementation uses a "toroidal world" in which the
  *     the last row of cells is adjacent to the first row, and
- *     the last column of cells is adjacent to the first.
+ *     the last column of cells is adjacent to the first.  In a world
+ *     with fewer than three rows or columns some of the eight
+ *     neighbors of a cell are the same cell (or the cell itself), and
+ *     each of them is counted, so any m, n >= 1 is allowed.
+ * 2.  The world is bit-packed:  each row is stored as W = ceil(n/64)
+ *     64-bit words, with column j in bit j%64 of word j/64.  Bits
+ *     past column n-1 are always 0.  The wrap-around is handled with a
+ *     halo:  each row has a ghost word on either side (bit 63 of the
+ *     west one is a copy of column n-1, and bit 0 of the east one is a
+ *     copy of column 0), and there's a ghost row above row 0 and below
+ *     row m-1.  So the buffer has m+2 rows of W+2 words, which are
+ *     stored pitch words apart.  pitch is rounded up to whole cache
+ *     lines, and word 0 of every row starts a cache line, so vector
+ *     loads don't straddle lines;  if that makes a row a multiple of
+ *     4 KiB, another line is added, so that the rows above and below
+ *     a word don't map to the same cache set.  Big worlds are backed
+ *     by huge pages to save TLB misses.  See Alloc_world and
+ *     Refresh_halo.
+ * 3.  The world is cut into tiles of at most tile_rows rows by
+ *     tile_words words, whose sizes differ by at most one (see
+ *     Decompose).  The tiles are numbered in row-major order, and at
+ *     the start of each generation every thread is given a contiguous
+ *     run of them in its own work queue.  A thread takes tiles from
+ *     the front of its queue, and when it's empty it steals half of
+ *     what's left from the back of another thread's queue.  So the
+ *     number of threads is independent of the tiling, and threads
+ *     whose part of the world is quiet help out where it's busy.  No
+ *     two threads ever write the same word.  With -b the time spent on
+ *     each tile is measured, and the runs are periodically chosen so
+ *     that they take about the same time (see Rebalance).
+ * 4.  A new generation is computed a word (64 cells) at a time by a
+ *     bit-sliced adder:  the eight neighbors of every cell in a word
+ *     are summed with bitwise full adders, so no cell is ever looked
+ *     at individually.  The interior words of each row are handled by
+ *     a vectorized copy of the adder (AVX-512, AVX2 or NEON) chosen at
+ *     run time by Select_kernel.  Because of the halo the same
+ *     kernel does every word of every row, without any wrapping;  only
+ *     the last word of a row and the ghost cells need special
+ *     treatment (see Update_row).
+ * 5.  The threads synchronize at the end of each generation with a
+ *     sense-reversing barrier:  arriving threads spin on a shared sense
+ *     flag for a while and only then sleep on a condition variable.
+ *     Each thread counts its live cells in its own cache line, and
+ *     the last thread to arrive at the barrier adds up the counts.
+ * 6.  Output doesn't hold up the computation.  At the barrier the
+ *     new generation is copied into a free snapshot buffer, and a
+ *     separate writer thread formats and prints the snapshots while
+ *     the other threads go on to the next generation.  The barrier
+ *     only waits for the writer when all the snapshot buffers are
+ *     still waiting to be printed.
+ * 7.  A tile is only recomputed if it or one of its eight neighbors
+ *     changed in the last generation.  Otherwise the new tile would
+ *     be the same as the current one, and since the current one is the
+ *     same as the previous one, which is what's already in the buffer
+ *     for the new generation, there's nothing to do.  Each ghost cell
+ *     is written along with the real cell it copies, so a skipped
+ *     tile's halo is up to date too.
+ * 8.  With -K k the threads compute up to k generations between
+ *     barriers.  The tiles are then whole bands of rows, and a thread
+ *     takes its band plus k rows above and below it through the k
+ *     generations in two scratch buffers of its own, one row fewer at
+ *     each end every generation (a trapezoid), so only the last of
+ *     the k generations goes back to memory.  The rows near the edges
+ *     of each band are computed by two threads, which costs about
+ *     (k-1)/tile_rows extra work, but the world is read and written
+ *     once per k generations instead of once per generation.  A block
+ *     of generations never runs past a generation that's printed or
+ *     rebalanced at.  Tile skipping (note 7) is off with -K.
+ * 9.  On a NUMA machine a page of memory goes on the node of the
+ *     thread that first touches it.  So the worlds aren't zeroed by
+ *     main:  each worker thread zeroes its own part of them before
+ *     generation 0 is read or generated.  With -N local (the default)
+ *     thread k zeroes the rows [k*m/t, (k+1)*m/t) it starts out with
+ *     when there are t threads;  with -N interleave thread k zeroes
+ *     every t-th page of each world starting at page k, which spreads
+ *     the pages over the nodes evenly.  Both pin thread k to the k-th
+ *     CPU the program may run on, if there are enough CPUs.  -N off
+ *     zeroes as local does, but lets the threads move.
+ * 10. Compiled with USE_MPI, the world is cut into bands of whole
+ *     rows, one per process, and m is the number of rows in this
+ *     process's band (world_m is the number in the whole world).  Each
+ *     band has halo = k ghost rows above and below it (k = 1 without
+ *     -K), which hold copies of the rows of the processes above and
+ *     below;  since ghost rows are whole rows with their ghost words,
+ *     the diagonal neighbors come along with them.  After each block
+ *     of generations the new boundary rows are sent with non-blocking
+ *     sends, and the threads compute the tiles that don't need the
+ *     ghost rows while they're on the way:  the first thread to take
+ *     a tile that does need them waits for them (see Wait_halo).  The
+ *     live counts are added up with an MPI_Allreduce.  Generation 0 is
+ *     generated by every process for its own rows, or read by process
+ *     0 and scattered, and worlds that are printed are gathered to
+ *     process 0, which has the only writer thread;  so only worlds
+ *     that are printed, or read, need to fit in one process.  Tile
+ *     skipping (note 7) is off with MPI.
+ * 11. With -E gpu the generations are computed on a GPU by the engine
+ *     in GoL_gpu.cu, instead of by the worker threads.  Generation 0
+ *     is set up on the host as usual and copied to the device, which
+ *     keeps both generations and runs a batch of generations at a
+ *     time, up to the next one that's printed (at most GPU_BATCH).
+ *     The live counts are added up on the device, and a generation
+ *     after one with no live cells isn't computed, so the device
+ *     stops at the same generation as the CPU engine.  The world is
+ *     only copied back to be printed.
+ * 12. With -E hashlife the world is a quadtree:  a node of level k is
+ *     a square of 2^k by 2^k cells made of four nodes of level k-1,
+ *     and a level 0 node is a cell.  Nodes are hash-consed, so equal
+ *     squares are the same node however often they appear, and each
+ *     node remembers its middle half 2^j generations on (see Hl_next),
+ *     so repeated and periodic parts of the world are only computed
+ *     once.  Getting from generation g to g + d takes one step of 2^j
+ *     generations for each bit j of d.  On the torus m and n have to
+ *     be powers of 2:  the world is tiled with copies of itself, which
+ *     keeps the wrap-around exact.  With -U the world is put in an
+ *     unbounded plane of dead cells instead, and the rows and cols
+ *     only say what part of the plane is printed;  the live counts
+ *     are for the whole plane.  When there are more than -m nodes,
+ *     the ones that can't be reached from the current generation are
+ *     freed between steps (see Hl_collect).  A step can still make
+ *     more nodes than that while it's running.
+ * 13. With -E sparse the world is a list of its live cells.  Each
+ *     generation every live cell adds one to the counts of its eight
+ *     neighbors in a hash table, and only the cells in the table can
+ *     be live in the next generation, so a generation takes time in
+ *     proportion to the population instead of to m*n.  With -E auto
+ *     the threads play the packed world, and at a barrier the last
+ *     thread takes the world over to the sparse engine when fewer
+ *     than one cell in SPARSE_RATIO*thread_count is live.  It gives
+ *     it back when more than twice that many are, so the engines
+ *     don't take turns every generation near the line.  Each switch
+ *     costs a pass over the packed world.  -E sparse has no packed
+ *     world at all:  generation 0 is read or generated straight into
+ *     the list, and a printed generation is drawn from the list into
+ *     the window's rows of its snapshot, so the memory and the time a
+ *     frame takes go with the population and the window, not m*n.
+ * 14. With -C p each tile keeps a hash of its cells, computed when the
+ *     tile is, so a skipped tile's hash is still right, and at each
+ *     barrier the tiles' hashes are combined into the world's.  The
+ *     last p of these are kept in a ring.  When the world's hash is
+ *     already in the ring, generation g repeats some generation g - q,
+ *     and the period q is reported on stderr.  From then on the world
+ *     at g + kq is the world at g, so at each barrier curr_gen jumps
+ *     ahead by as many periods as fit before the next generation that
+ *     has to be printed, and only the generations in between are
+ *     computed.  The hashes are 64 bits and the worlds aren't
+ *     compared, so two different worlds with the same hash could in
+ *     principle be taken for a cycle.  Cycles are only looked for at
+ *     the barriers, and so only on the cpu engine:  the others, and
+ *     -E auto once it has moved the world to the sparse engine, don't
+ *     hash the world, so -C is refused with them.  With -K the period
+ *     found can be a multiple of the least one.
+ * 15. With -B no generations are printed.  The clock starts at the
+ *     first barrier after the warmup generations, and max gens more
+ *     generations are then timed.  Each run prints one line:  the
+ *     configuration, the seconds taken, ns per generation, cell
+ *     updates per second (rows*cols*gens/seconds), and the mean time
+ *     a thread spent in the barrier per generation, which is the
+ *     time it was idle waiting for the other threads and for the
+ *     serial part.  csv starts with a header line, and json is one
+ *     object per line.  If r is a list, the run is done with each
+ *     r*s threads, and if rows or cols is a list, with each size
+ *     (lists of rows and cols go together, and a single value is
+ *     used with every entry of the other list).  Each run of a sweep
+ *     is a child process of its own, so it starts from a clean
+ *     process, and prompts go to stderr so stdout is only results.
+ * 16. Built with -DUSE_TRACE, each thread (and the writer) keeps its
+ *     own counters, in its own cache line:  the time spent computing
+ *     tiles, spinning and parked in the barrier, running the serial
+ *     part of a barrier, and copying or printing snapshots, the tiles
+ *     computed and skipped and the cells they hold, and, where
+ *     perf_event_open is allowed, the thread's cycles and cache
+ *     misses.  They're printed on stderr at the end.  With -Q each of
+ *     these spans also goes in a timeline in the Chrome trace format,
+ *     for chrome://tracing or Perfetto.  Without USE_TRACE the
+ *     TRACE_ macros are empty, and none of this is compiled.
+ * 17. A checkpoint is the world exactly as it is in memory:  a page
+ *     with a Ckpt_header_t, and then the buffer from Alloc_world,
+ *     WORLD_LEAD words, ghost rows and padding included.  The barrier
+ *     queues it like a snapshot to be printed, and the writer thread
+ *     writes it, so the threads don't wait for the disk.  With -r the
+ *     file is mapped copy-on-write as the first world, if the run
+ *     lays its worlds out the same way (the same pitch and halo, and
+ *     one process), so nothing is parsed or copied, and pages are
+ *     only read as they're used.  The first time a generation is
+ *     stored in a page it gets a private copy, so after two
+ *     generations the world has gone from the file to memory placed
+ *     by the threads that write it.  Otherwise, as with MPI, the
+ *     world is copied in out of the mapped file row by row.  The
+ *     header has the rule, and -r refuses a checkpoint of another
+ *     rule.  A checkpoint only holds the m x n world, so there are
+ *     none of the unbounded plane of -U, and none with -E sparse,
+ *     which never makes the packed world.
+ * 18. With -R the barrier only copies the window's rows into the
+ *     snapshot, and with MPI only those rows are gathered, so the cost
+ *     of a frame grows with the window and not with the world.  (A
+ *     checkpoint still copies the whole world.)  With -D k each
+ *     character of the ascii output is a k x k block of the window,
+ *     blank if it's dead:  for k <= 3 a digit is the number of live
+ *     cells, and for bigger blocks it's that number scaled to 1-9,
+ *     rounded up.  Blocks on the right and bottom edges of the window
+ *     may be smaller.  In the packed format a downsampled world is a
+ *     Packed_header_t with the magic "GoLD", m and n the number of
+ *     rows and cols of blocks, and words = k, followed by the counts
+ *     as m x n uint32_t's.
+ * 19. A rule is a pair of 9-bit masks:  bit k of rule_birth is set if
+ *     a dead cell with k live neighbors comes to life, and bit k of
+ *     rule_survive if a live one stays alive.  The packed kernels get
+ *     the rule as two macro args, so each of the rules in the rules
+ *     table in GoL_lib.c (conway B3/S23, highlife B36/S23, daynight
+ *     B3678/S34678, seeds B2/S, lwod B3/S012345678, maze B3/S12345 and
+ *     replicator B1357/S1357) has kernels of its own, whose boolean
+ *     networks are reduced to just the counts the rule uses, and
+ *     B3/S23 keeps its three-gate formula.  Any other rule runs on the
+ *     generic kernels, which and the minterms of all nine counts with
+ *     masks made from the rule;  the kernel name ends in -generic
+ *     then.  A rule with B0 brings dead space to life, so it only runs
+ *     on the cpu engine, where the tile skipping and cycle detection
+ *     still work since they only depend on the rule being the same
+ *     every generation, and a world that dies isn't the end of the
+ *     run.
+ * 20. With -M the worlds of an ensemble are independent, so instead of
+ *     cutting each of them into tiles, the r*s threads each take whole
+ *     worlds off a shared counter and play them one after another in
+ *     a Life_t of their own from the library (see note 21), which only
+ *     recomputes the rows whose neighborhoods changed.  So there's one
+ *     process, one set of threads and buffers, and no barriers, however
+ *     many worlds there are.  Each world's generations are hashed as
+ *     with -C, and once one repeats one of the last ring (the -C
+ *     value, or ENS_RING) the world's period is known, and whole
+ *     periods are skipped.  A world that has died is done.
+ * 21. GoL_lib.c is a library that plays worlds through Life_t handles
+ *     (see GoL_lib.h), without globals, argv, stdin or stdout, so a
+ *     program can create, seed or load, step and read any number of
+ *     worlds in-process.  The two share one engine:  the word kernels
+ *     of notes 4 and 19, with the rules table, and the test of whether
+ *     a tile's neighborhood changed, are in the library, and take the
+ *     row length and rule as args, so Update_row calls the kernel
+ *     Life_get_kernel picked, and Tile_active calls Life_active.  The
+ *     hashes, the soups and the text loader are the library's too
+ *     (note 6 in GoL_lib.h), so -V and -M compare and seed worlds
+ *     with the same code as the engines, with no round trip through a
+ *     double.  What's left here is what's built around the globals
+ *     and threads of this file:  the parallel tiles, -K, MPI, the GPU,
+ *     hashlife and the sparse engine, which don't go through Life_t
+ *     and which the library doesn't have (see note 4 in GoL_lib.h),
+ *     and the RLE parser.  This program uses Life_t for -M and -V, and
+ *     for parsing rules.
+ * 22. With -s the stats are reduced in the kernels' pass over the
+ *     world rather than in a pass of their own:  as each new row is
+ *     stored, Row_stats compares it with the old one while both are
+ *     still in cache, and that loop takes the place of the one that
+ *     sees whether the tile changed.  Each tile keeps its stats, so a
+ *     tile that isn't recomputed adds its box with no births or
+ *     deaths, and each thread adds its tiles up in a Stats_t of its
+ *     own for each generation of the block, like the live counts.
+ *     (Row_stats is picked along with Life_kernel, to use the CPU's
+ *     popcount instruction.)  The last thread into the barrier merges
+ *     the threads' stats (and with MPI the processes'), bins the
+ *     tiles by their live counts, and writes a line per generation to
+ *     a buffered file.  With -K the bands record their counts for
+ *     every generation of the block, so nothing is lost there either.
+ *     The box is of the world as it is stored, not the smallest one
+ *     around the torus.  Generations skipped by -C have no lines.
+ * 23. The delta format is for long runs of big worlds, most of which
+ *     is still, whose packed output would be mostly copies of the same
+ *     words.  The writer thread keeps the last world it wrote, and
+ *     each frame carries only the words that changed since that one,
+ *     so a reader replays the frames in order from a keyframe.  As
+ *     the changes are relative to the last world printed, they can
+ *     span any number of generations with -o k or -C.  Every k-th
+ *     frame is a keyframe so a reader can start there, and a change
+ *     frame that would be no smaller than a keyframe is written as
+ *     one.  The encoding and the compression are done by the writer
+ *     thread, so they don't hold up the computation any more than the
+ *     other formats do.
+ * 24. -V is a regression check for the engines.  The worlds are a
+ *     blinker, a glider that comes back to where it started on a 64 x
+ *     64 torus, a Gosper gun after four gliders and an R-pentomino
+ *     at generation 1103, when it has settled to 116 cells, and a
+ *     soup from the command line.  The library (see note 21) is
+ *     checked against the known answers first (with B3/S23), and then
+ *     it's the reference:  each engine, with one and r*s threads, -a,
+ *     small tiles and -K, must end with the library's world, by live
+ *     count and hash.  As with the benchmark sweeps, each run is a
+ *     child process that starts from scratch, and each is timed at
+ *     least CHECK_REPEATS times, and then until the runs have taken
+ *     CHECK_TIME_NS (or CHECK_MAX_REPEATS runs).  The best time per
+ *     generation is compared with the baseline file's, and one more
+ *     than CHECK_SLACK times the baseline is slow, unless the run is
+ *     too short to time.  A slow run is a warning, not a failure:  a
+ *     busy machine can make any run slow, so the exit status is 2 if
+ *     runs were slow but none was wrong, and 1 if any was wrong.  To
+ *     take a new baseline, remove the file.  Under MPI only the soup
+ *     is played, on the cpu engine, and there's no baseline.
+ * 25. -A looks up the host name, rows, cols and rule in the tuning file
+ *     and, if they aren't there yet, tunes by coordinate search:  it
+ *     times the threads (powers of 2 up to the number of CPUs this
+ *     process may run on, and that number) with the default kernel and
+ *     tiles, then each kernel with the fastest threads, then a few
+ *     tile shapes, and then a few depths for -K, keeping the fastest of
+ *     each.  Like the benchmark sweeps, each run is a child process
+ *     that starts from generation 0 of the real world (a world from
+ *     stdin can't be read twice, so it's tuned on a soup of the same
+ *     size), and it's timed for TUNE_GENS generations after
+ *     TUNE_WARMUP.  The configuration that won is added to the file,
+ *     and the run goes on with it.  Later runs of the same size and
+ *     rule on the host start with it, without timing anything.  To
+ *     tune again, remove the line.
  *
  */
+#define _GNU_SOURCE     /* For CPU affinity */
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
 #include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <time.h>
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+#ifdef USE_TRACE
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+#ifdef USE_LZ4
+#include <lz4.h>
+#endif
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+#include "GoL_lib.h"
+#if defined(USE_MPI) && defined(USE_CUDA)
+#error "The GPU engine doesn't run under MPI"
+#endif
 
 //#define DEBUG
 
@@ -61,82 +552,877 @@
 #define DEAD_IO ' '
 #define MAX_TITLE 1000
 
+/* Output formats */
+#define FMT_ASCII 0
+#define FMT_PACKED 1
+#define FMT_RLE 2
+#define FMT_DELTA 3
+#define RLE_LINE 70
+
+/* The delta format (see note 23):  a keyframe every DELTA_KEYFRAME
+ * frames unless -f delta,<k> says otherwise, and the codecs that -z
+ * can compress the frames with
+ */
+#define DELTA_KEYFRAME 100
+#define CODEC_NONE 0
+#define CODEC_LZ4 1
+#define CODEC_ZSTD 2
+#define ZSTD_LEVEL 3
+
+/* Benchmark formats (see note 15) */
+#define BENCH_OFF 0
+#define BENCH_CSV 1
+#define BENCH_JSON 2
+#define BENCH_CHECK 3   /* Timed, and reported to -V (see note 24) */
+#define BENCH_TUNE 4    /* Timed, and reported to -A (see note 25) */
+#define BENCH_WARMUP 10
+/* Most entries in a list of thread counts or sizes */
+#define BENCH_MAX 64
+
+/* Most worlds in an ensemble, and the longest period looked for in
+ * them without -C (see note 20)
+ */
+#define ENS_MAX (1 << 24)
+#define ENS_RING 64
+
+/* Tiles are binned by density in tenths for -s, plus a bin for empty
+ * tiles (see note 22)
+ */
+#define STATS_BINS 10
+
+/* Each -V run is timed at least CHECK_REPEATS times, and then until the
+ * runs have taken CHECK_TIME_NS, up to CHECK_MAX_REPEATS.  It's slow if
+ * the best time per generation is more than CHECK_SLACK times its
+ * baseline's, unless the run takes less than CHECK_MIN_NS.  A run's
+ * name, which is its key in the baseline file, is at most CHECK_NAME
+ * chars, and the file has at most CHECK_MAX of them (see note 24).
+ */
+#define CHECK_REPEATS 5
+#define CHECK_MAX_REPEATS 25
+#define CHECK_TIME_NS 5.0e8
+#define CHECK_SLACK 1.25
+#define CHECK_MIN_NS 1.0e7
+#define CHECK_NAME 128
+#define CHECK_MAX 256
+
+/* -A times each configuration for TUNE_GENS generations after
+ * TUNE_WARMUP, in TUNE_STAGES stages of at most TUNE_CANDS each.  A
+ * world from stdin is tuned on a soup of TUNE_PROB (see note 25).
+ */
+#define TUNE_WARMUP 2
+#define TUNE_GENS 16
+#define TUNE_STAGES 4
+#define TUNE_CANDS 16
+#define TUNE_PROB 0.3
+
+typedef uint64_t word_t;
+#define WORD_BITS 64
+
+/* The masks of B3/S23 (see note 19) */
+#define CONWAY_BIRTH 0x008
+#define CONWAY_SURVIVE 0x00C
+#define Word_count(n) (((n) + WORD_BITS - 1)/WORD_BITS)
+
+#define CACHE_LINE 64
+
+/* Words in a cache line, and the words before word 0 of row -1 in a
+ * world, which make word 0 of each row start a cache line
+ */
+#define LINE_WORDS (CACHE_LINE/sizeof(word_t))
+#define WORLD_LEAD (LINE_WORDS - 1)
+
+/* What the worlds' memory is backed by */
+#define HUGE_OFF 0
+#define HUGE_THP 1
+#define HUGE_TLB 2
+#define HUGE_PAGE (2 << 20)
+
+/* Tags for the rows sent to the processes above and below */
+#define HALO_NORTH 1
+#define HALO_SOUTH 2
+
+/* Engines that compute the generations */
+#define ENGINE_CPU 0
+#define ENGINE_GPU 1
+#define ENGINE_HASHLIFE 2
+#define ENGINE_SPARSE 3
+#define ENGINE_AUTO 4
+/* -E auto goes sparse below one live cell in SPARSE_RATIO per thread */
+#define SPARSE_RATIO 256
+/* Most generations the GPU computes between copies of the live counts */
+#define GPU_BATCH 1024
+
+/* A square of 2^level cells on a side in HashLife (see note 12) */
+typedef struct Hl_node_s {
+    struct Hl_node_s *nw, *ne, *sw, *se;  /* Quadrants;  NULL at level 0 */
+    struct Hl_node_s *result;   /* Memoized Hl_next, or NULL */
+    struct Hl_node_s *next;     /* Next in its bucket, or in the free list */
+    long live;                  /* Live cells in the square */
+    signed char level;
+    signed char result_log;     /* result is 2^result_log gens on */
+    char mark;                  /* Reached by Hl_collect */
+} Hl_node_t;
+
+/* HashLife nodes are allocated HL_CHUNK at a time */
+#define HL_CHUNK 65536
+typedef struct Hl_chunk_s {
+    struct Hl_chunk_s *prev;
+    Hl_node_t nodes[HL_CHUNK];
+} Hl_chunk_t;
+#define HL_LEVELS 64
+#define HL_MAX_NODES (1L << 22)
+
+/* A cell's slot in the sparse engine's hash table (see note 13) */
+typedef struct {
+    uint64_t key;       /* See Sp_key;  SP_EMPTY if the slot is free */
+    int count;          /* Live neighbors, plus SP_LIVE if it's live */
+} Sp_slot_t;
+#define SP_EMPTY UINT64_MAX
+#define SP_LIVE 16
+
+/* Memory placement policies (see note 9) */
+#define NUMA_OFF 0
+#define NUMA_LOCAL 1
+#define NUMA_INTERLEAVE 2
+
+/* Default maximum size of the tiles the world is cut into */
+#define TILE_ROWS 32
+#define TILE_WORDS 8
+/* How many times a thread polls the barrier before going to sleep */
+#define BARRIER_SPINS 20000
+
+#if defined(__x86_64__) || defined(__i386__)
+#  define Cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#  define Cpu_relax() __asm__ __volatile__ ("yield")
+#else
+#  define Cpu_relax() ((void) 0)
+#endif
+
+/* Work done by the last thread to reach a barrier */
+typedef void Serial_t(void);
+
+/* Number of snapshot buffers shared by Pointer_swap and the writer */
+#define SNAPSHOTS 2
+
+/* A copy of the world waiting to be printed or checkpointed */
+typedef struct {
+    word_t *world;
+    int gen;
+    long live;
+    int what;           /* SNAP_PRINT and/or SNAP_CHECKPOINT */
+} Snapshot_t;
+#define SNAP_PRINT 1
+#define SNAP_CHECKPOINT 2
+
+/* Starts a checkpoint file (see note 17) */
+typedef struct {
+    char magic[8];          /* CKPT_MAGIC */
+    int32_t m, n;           /* The whole world's rows and cols */
+    int32_t pitch, halo;    /* How the world buffer that follows is laid out */
+    int64_t gen, live;
+    int32_t birth, survive; /* The rule (see note 19) */
+} Ckpt_header_t;
+#define CKPT_MAGIC "GoLCkpt"
+/* The world buffer starts this far into the file, a page boundary */
+#define CKPT_HEADER 4096
+
+/* Precedes each world in the packed output format */
+typedef struct {
+    char magic[4];          /* "GoLP" */
+    int32_t m, n;
+    int32_t words;          /* words per row */
+    int64_t gen, live;
+} Packed_header_t;
+
+/* Precedes each frame in the delta output format (see note 23) */
+typedef struct {
+    char magic[4];          /* "GoLK" for a keyframe, "GoLC" for changes */
+    int32_t m, n;
+    int32_t words;          /* words per row */
+    int64_t gen, live;
+    int64_t count;          /* Words in the frame, or words that changed */
+    int32_t codec;          /* CODEC_NONE, CODEC_LZ4 or CODEC_ZSTD */
+    int32_t pad;            /* 0 */
+    int64_t raw_bytes;      /* Size of the payload before compression, */
+    int64_t bytes;          /*    and as written */
+} Delta_header_t;
+
+/* A thread's queue of tiles [head, tail), alone in its cache line.  The
+ * owner takes tiles from the head and thieves take them from the tail;
+ * both update head and tail together with a compare and swap.
+ */
+typedef struct {
+    _Atomic uint64_t range;     /* head in the low 32 bits, tail above */
+    char pad[CACHE_LINE - sizeof(uint64_t)];
+} Deque_t;
+
+#define Pack_range(head, tail) (((uint64_t) (tail) << 32) | (uint32_t) (head))
+#define Range_head(range) ((int) ((range) & 0xffffffff))
+#define Range_tail(range) ((int) ((range) >> 32))
+
+/* Number of longs in a cache line */
+#define LINE_LONGS (CACHE_LINE/sizeof(long))
+
+#ifdef USE_TRACE
+/* A span of a thread's time in the timeline (see note 16) */
+typedef struct {
+    const char *name;
+    double start, dur;          /* ns, from Trace_now */
+} Trace_event_t;
+
+/* A thread's counters, alone in their cache lines */
+typedef struct {
+    double compute_ns, spin_ns, park_ns, serial_ns, io_ns;
+    long tiles, skipped, cells, parks;
+    int perf_fd[2];             /* Cycles and cache misses, or -1 */
+    Trace_event_t *events;      /* NULL without -Q */
+    int event_count, dropped;
+} __attribute__ ((aligned (CACHE_LINE))) Trace_t;
+#define TRACE_EVENTS (1 << 16)
+
+/* Time the code between TRACE_BEGIN(t) and TRACE_END(t, ...) */
+#  define TRACE_BEGIN(t) double t = Trace_now()
+#  define TRACE_END(t, name, field) \
+      Trace_span(name, t, &traces[trace_rank].field)
+#  define TRACE_COUNT(field, k) (traces[trace_rank].field += (k))
+#else
+#  define TRACE_BEGIN(t) ((void) 0)
+#  define TRACE_END(t, name, field) ((void) 0)
+#  define TRACE_COUNT(field, k) ((void) 0)
+#endif
+
+/* One world of an ensemble, and what became of it (see note 20) */
+typedef struct {
+    uint64_t seed;
+    uint64_t threshold;     /* Its prob, as for gen_threshold */
+    int gens;               /* Generations played */
+    long live;              /* Live cells after them */
+    int extinct;            /* Generation when every cell had died, or -1 */
+    int period;             /* Of the cycle it ended in, or 0 */
+} Ens_world_t;
+
+/* What -s counts in a part of a world for a generation (see note 22).
+ * The box is top, left, -bottom and -right of the live cells, so that
+ * boxes are merged with min, or all INT_MAX if there are none.
+ */
+typedef struct {
+    long births, deaths;
+    int box[4];
+} Stats_t;
+
+/* Adds the stats of words [first, last) of row i of the next
+ * generation to stats, given the row in the current one, and returns
+ * the OR of their XORs (see DEFINE_ROW_STATS)
+ */
+typedef word_t Stats_fn(Stats_t *stats, const word_t old[],
+      const word_t row[], int i, int first, int last);
+
+/* A world that -V plays on each engine (see note 24) */
+typedef struct {
+    const char *name;
+    const char *text;       /* Generation 0 in the X/space format, or NULL
+                               for a soup of the command line's size */
+    int rows, cols;         /* The world's size, */
+    int row, col;           /* where the text goes, */
+    int gens;               /* and how long it's played for */
+    long live;              /* The live cells after gens with B3/S23, */
+    const char *after;      /* and the world, at after_row, after_col, */
+    int after_row, after_col;   /* if they're known;  -1 and NULL if not */
+} Check_case_t;
+
+/* How -V plays the worlds on an engine */
+typedef struct {
+    const char *name;       /* With %d for the number of threads */
+    int engine;
+    int threads;            /* 0 for r*s */
+    int depth;              /* 0 for the command line's, */
+    int track_active;
+    int tile_rows, tile_words;      /* and 0 for its tiles */
+} Check_config_t;
+
+/* A run's time per generation, by its name */
+typedef struct {
+    char name[CHECK_NAME];
+    double ns_per_gen;
+} Check_base_t;
+
+/* A configuration -A tries (see note 25) */
+typedef struct {
+    int threads;
+    int isa;                /* Index in kernel_isas in GoL_lib.c */
+    int tile_rows, tile_words;
+    int depth;
+    double ns_per_gen;      /* Its time, or -1 if it hasn't been timed */
+} Tune_t;
+
 /* Global variables */
 int thread_count;
 int r, s, m, n;
-int *wp, *twp;
+int world_m;            /* Rows in the whole world;  this process has m */
+int row0 = 0;           /* This process has rows [row0, row0+m) of it */
+int halo = 1;           /* Ghost rows above and below the real ones */
+int mpi_rank = 0, mpi_size = 1;
+int W, pitch;
+word_t *wp, *twp;
 int max_gens;
-int barrier_count = 0;
+atomic_int barrier_count = 0;
+atomic_int barrier_sense = 0;
+atomic_int parked_count = 0;
+int barrier_spins;
 int curr_gen = 0;
-int live_count;
+long live_count;
+long *live_counts;      /* Thread k's count for gen t of a block is */
+int live_stride;        /*    live_counts[k*live_stride + t] */
+long *block_live;       /* Live cells after each gen of a block */
+char *stats_file = NULL;        /* Where -s writes the stats */
+FILE *stats_out;        /* and the file, on process 0 */
+Stats_t *stats_counts;  /* Thread k's stats for gen t of a block, as with
+                           live_counts */
+Stats_t *block_stats;   /* Stats of each gen of a block */
+Stats_t *tile_stats;    /* Of each tile when it was last computed */
+long *band_live;        /* With -K, live cells in band ti in gen t of a
+                           block are band_live[t*tile_m + ti] */
+long stats_births = 0, stats_deaths = 0;        /* In the benchmark */
+int depth = 1;          /* Max gens per barrier */
+int block_gens = 1;     /* Gens in the current block */
 int break_flag = 0;
 pthread_mutex_t barrier_mutex;
 pthread_cond_t ok_to_proceed;
+Snapshot_t snapshots[SNAPSHOTS];
+int snap_first = 0, snap_queued = 0;
+int writer_done = 0;
+pthread_t writer_handle;
+pthread_mutex_t snap_mutex;
+pthread_cond_t snap_ready, snap_free;
+Life_kernel_t *Life_kernel;   /* From GoL_lib.c (see note 21) */
+const char *kernel_name;
+Stats_fn *Row_stats;    /* The -s kernel that goes with Life_kernel */
+int out_every = 1;      /* Print every out_every-th gen, 0 for none */
+int out_final = 0;      /* Print the last generation computed */
+int out_format = FMT_ASCII;
+int delta_every = DELTA_KEYFRAME;       /* Frames from keyframe to keyframe */
+int delta_codec = CODEC_NONE;
+long delta_frames = 0;  /* Frames written in the delta format */
+word_t *delta_prev, *delta_cur;         /* The last frame, and this one */
+unsigned char *delta_buf, *delta_zbuf;  /* A payload, and compressed */
+size_t delta_zcap;      /* Room in delta_zbuf */
+#ifdef USE_ZSTD
+ZSTD_CCtx *delta_zstd;
+#endif
+int out_header = 0;
+int generate = 0;       /* The threads generate generation 0 */
+uint64_t gen_seed = 1;
+uint64_t gen_threshold; /* A cell is alive if its hash is less */
+int track_active = 1;   /* Skip tiles whose neighborhoods didn't change */
+int tile_rows = TILE_ROWS, tile_words = TILE_WORDS;
+int tile_m, tile_n;     /* Number of rows and cols of tiles */
+int *tile_row0;         /* Tile row ti has rows [tile_row0[ti], [ti+1]) */
+int *tile_word0;        /* Tile col tj has words [tile_word0[tj], [tj+1]) */
+Deque_t *deques;        /* One per thread */
+int *seed_start;        /* Thread k starts with tiles [seed_start[k], [k+1]) */
+int rebalance_every = 0;        /* 0 means never */
+double *tile_cost;      /* ns spent on each tile since the last rebalance */
+unsigned char *changed, *next_changed;  /* Per tile, previous/this gen */
+long *tile_live;        /* Live cells in each tile */
+char *in_file = NULL;   /* Read generation 0 from here, not stdin */
+char input_char;        /* 'i' or 'g' from the command line */
+int numa_policy = NUMA_LOCAL;
+int *thread_cpu = NULL; /* Thread k runs on thread_cpu[k];  NULL if unpinned */
+size_t page_words;      /* Words in a page of the worlds */
+int huge_pages = HUGE_THP;
+int engine = ENGINE_CPU;
+int hl_plane = 0;       /* HashLife on the unbounded plane */
+long hl_max_nodes = HL_MAX_NODES;
+Hl_node_t **hl_table;   /* Hash table of all the nodes */
+size_t hl_buckets;      /* Its size, a power of 2 */
+long hl_nodes = 0;      /* Nodes in it */
+Hl_node_t *hl_free = NULL;      /* Unused nodes */
+Hl_chunk_t *hl_chunks = NULL;
+Hl_node_t hl_cell[2];   /* The level 0 nodes, DEAD and LIVE */
+Hl_node_t *hl_empty[HL_LEVELS]; /* The empty node of each level */
+Hl_node_t *hl_root;     /* The current generation */
+int hl_level;           /* Level of the tile on the torus */
+uint64_t *sp_cells = NULL;      /* The sparse engine's live cells */
+uint64_t *sp_next = NULL;       /* and the next generation's */
+long sp_count;          /* Cells in sp_cells */
+long sp_alloc = 0;      /* Room in sp_cells and sp_next */
+Sp_slot_t *sp_table = NULL;
+size_t sp_slots;        /* Slots in use in sp_table, a power of 2 */
+size_t sp_table_alloc = 0;
+int in_row = 0, in_col = 0;    /* Where to put the input pattern */
+int view_whole = 1;     /* No -R:  the window is the whole world */
+int view_row, view_col; /* The printed window's top left cell */
+int view_m, view_n;     /* and its size */
+int view_scale = 1;     /* Print counts of view_scale^2 blocks if > 1 */
+int rule_birth = CONWAY_BIRTH;  /* Counts at which a dead cell is born */
+int rule_survive = CONWAY_SURVIVE;  /* and at which a live one lives */
+char rule_name[24] = "B3/S23";
+Ens_world_t *ens_worlds;        /* The ensemble's worlds, */
+long ens_count = 0;             /* how many of them there are, */
+atomic_long ens_next = 0;       /* and the next one to be played */
+int ens_prompt;         /* Ask for the ensemble's prob */
+uint64_t *tile_hash;    /* Hash of each tile (see note 14) */
+int cycle_ring = 0;     /* Longest period looked for;  0 for none */
+uint64_t *ring_hash;    /* Hashes of the last cycle_ring generations */
+int *ring_gen;          /* and which generations they were */
+int ring_next = 0;      /* Slot for the next one */
+int cycle_period = 0;   /* Period of the cycle found, or 0 */
+int bench_format = BENCH_OFF;
+int bench_warmup = 0;   /* Untimed generations before the clock starts */
+int bench_started = 0;  /* The clock has started */
+int bench_gen0;         /* at this generation, */
+struct timespec bench_start;    /* at this time */
+double *bench_wait;     /* ns each thread spent in timed barriers */
+char *bench_threads, *bench_rows, *bench_cols;  /* Lists in the args */
+FILE *prompt_file;      /* Where the prompts for input go */
+char *check_file = NULL;        /* -V's baseline file */
+const Check_case_t *check_case; /* The world a -V run plays, */
+const Check_config_t *check_config;     /* and how */
+char check_name[CHECK_NAME];    /* The run's name */
+int check_fd = -1;      /* Where a -V or -A run sends its time */
+char *tune_file = NULL; /* -A's tuning file */
+int kernel_isa = -1;    /* The kernel_isas entry to use;  -1 for the widest */
+int check_status = 0;   /* main's exit status:  1 if a -V run was wrong */
+int ckpt_every = 0;     /* Checkpoint every ckpt_every-th gen, 0 for none */
+char *ckpt_file = NULL;
+char *restart_file = NULL;      /* Start from this checkpoint */
+word_t *mapped_world = NULL;    /* The world mapped from it, if it is */
+#ifdef USE_TRACE
+Trace_t *traces;        /* Per thread, and the writer's last */
+_Thread_local int trace_rank = 0;       /* The calling thread's slot */
+struct timespec trace_zero;
+char *trace_file = NULL;        /* Where -Q writes the timeline */
+#endif
+#ifdef USE_MPI
+MPI_Datatype row_type;  /* A row of pitch words */
+int *proc_row0;         /* Process k has rows [proc_row0[k], [k+1]) */
+int *proc_rows;         /* and proc_rows[k] of them */
+int *view_row0;         /* Process k has the window's rows */
+int *view_rows;         /* [view_row0[k], view_row0[k]+view_rows[k]) */
+MPI_Request halo_requests[4];
+atomic_int halo_ready = 1;      /* The ghost rows have arrived */
+pthread_mutex_t halo_mutex;
+#endif
 
 /* Functions */
 void Usage(char prog_name[]);
-void Read_world(char prompt[], int wp[], int m, int n);
-void Gen_world(char prompt[], int wp[], int m, int n);
-void Print_world(char title[], int wp[], int m, int n);
+char Get_args(int argc, char* argv[]);
+void Set_size(int rows, int cols);
+void Bench_sweep(char prog_name[]);
+int  Parse_list(const char str[], int list[]);
+void Bench_report(struct timespec finish);
+void Check_sweep(void);
+int  Check_known(const Check_case_t *c);
+int  Check_skip(const Check_config_t *config, int rows, int cols);
+Life_t *Check_world(const char text[], int row, int col, int gens);
+int  Read_baseline(Check_base_t base[]);
+void Write_baseline(Check_base_t runs[], int count);
+void Check_report(struct timespec finish);
+pid_t Fork_run(double *ns_per_gen, int *status);
+double Timed_ns_per_gen(struct timespec finish);
+void Tune_sweep(void);
+int  Tune_candidates(int stage, const Tune_t *best, Tune_t cand[]);
+void Tune_apply(const Tune_t *tune);
+int  Read_tuning(const char host[], Tune_t *tune);
+void Write_tuning(const char host[], const Tune_t *tune);
+void Tune_report(struct timespec finish);
+void Read_world(char prompt[], word_t wp[], int m);
+void Load_world(char file[], word_t wp[]);
+void Parse_text(const char buf[], size_t len, word_t wp[], int is_cells);
+void Parse_rle(const char buf[], size_t len, word_t wp[]);
+const char *Skip_rle_header(const char *p, const char *end,
+      const char **header);
+void Check_rle_rule(const char header[], const char *end);
+void Get_prob(char prompt[]);
+void Get_world(void);
+void Find_cpus(void);
+void First_touch(word_t buf[], long my_rank);
+word_t *Alloc_world(size_t rows);
+void Free_world(word_t buf[], size_t rows);
+size_t World_bytes(size_t rows);
+size_t World_page(size_t rows);
+void Gen_world(word_t wp[], int first_row, int last_row, uint64_t seed,
+      uint64_t threshold);
+void Start_play(void);
+void End_generation(void);
+uint64_t World_hash(word_t wp[]);
+void Check_cycle(uint64_t hash);
+void Start_stats(void);
+void Write_stats(int gen, const Stats_t *stats, long live,
+      const long counts[]);
+void Print_world(char title[], word_t wp[], int first_row,
+      int first_col, int m, int n);
+void Print_counts(char title[], word_t wp[]);
+void Write_packed(word_t wp[], int gen, long live);
+void Write_counts(word_t wp[], int gen, long live);
+void Write_delta(word_t wp[], int gen, long live);
+void Write_rle(word_t wp[], int gen, long live);
+long Count_live(word_t wp[]);
 void *Play_life(void* rank);
-int  Count_nbhrs(int *wp, int m, int n, int i, int j);
-void Barrier(void);
+int  Count_nbhrs(word_t *wp, int m, int n, int i, int j);
+void Select_kernel(void);
+int  Parse_rule(const char str[]);
+void Rule_string(int birth, int survive, char str[]);
+long Update_row(const word_t above[], const word_t row[],
+      const word_t below[], word_t out[], int first, int last);
+void Refresh_halo(word_t wp[]);
+void Copy_to_ghost_row(word_t ghost[], const word_t row[], int first,
+      int last);
+int  Tile_active(int ti, int tj);
+long Update_tile(int ti, int tj, Stats_t *stats);
+void Update_block(int ti, long live[], word_t *scratch[], Stats_t stats[]);
+void Plan_block(void);
+void Decompose(void);
+int  Split_band(int first, int last, int max_size, int starts[]);
+void Rebalance(void);
+void Balance_bands(const double cost[], int count, int bands, int start[]);
+void Seed_deques(void);
+int  Get_tile(long my_rank);
+void Barrier(int *my_sense, Serial_t serial);
 void Pointer_swap(void);
+void Start_writer(void);
+void Stop_writer(void);
+void Queue_snapshot(word_t wp[], int gen, long live, int what);
+int  Snapshot_due(int gen);
+word_t *Open_checkpoint(char file[]);
+void Read_checkpoint(char file[], word_t wp[]);
+void Write_checkpoint(Snapshot_t *snap);
+int  Parse_ensemble(const char str[]);
+void Play_ensemble(void);
+void *Ens_thread(void* ignore);
+void Ens_play(Ens_world_t *world, Life_t *life, uint64_t hashes[],
+      int ring);
+void *Write_snapshots(void* ignore);
+void Play_hashlife(void);
+Hl_node_t *Hl_find(Hl_node_t *nw, Hl_node_t *ne, Hl_node_t *sw,
+      Hl_node_t *se);
+void Hl_grow(void);
+void Hl_rehash(size_t buckets);
+Hl_node_t *Hl_empty(int level);
+Hl_node_t *Hl_center(Hl_node_t *node);
+Hl_node_t *Hl_base(Hl_node_t *node);
+Hl_node_t *Hl_next(Hl_node_t *node, int log);
+Hl_node_t *Hl_build(word_t wp[], int level, long top, long left);
+void Hl_store(Hl_node_t *node, word_t wp[], long top, long left);
+void Hl_start(word_t wp[]);
+Hl_node_t *Hl_step(Hl_node_t *root, int log);
+long Hl_advance(long gens);
+int  Hl_try(int log, long *done);
+long Hl_live(void);
+void Hl_to_world(word_t wp[]);
+void Hl_collect(void);
+void Hl_mark(Hl_node_t *node);
+void Hl_stop(void);
+void Play_sparse(void);
+void Try_sparse(void);
+int  Run_sparse(void);
+void Sp_from_world(word_t wp[]);
+void Sp_to_world(word_t wp[]);
+long Sp_play(int gens);
+long Sp_step(void);
+void Sp_add(uint64_t key, int inc);
+void Sp_reserve(long count);
+void Sp_append(uint64_t key);
+void Sp_unique(void);
+void Sp_generate(uint64_t seed, uint64_t threshold);
+void Sp_to_window(word_t wp[]);
+uint64_t Sp_hash(void);
+void Sp_stop(void);
+#ifdef USE_CUDA
+void Play_gpu(void);
+/* In GoL_gpu.cu */
+int  Gpu_start(const uint64_t world[], int m, int n, int W, int pitch,
+      int birth, int survive);
+int  Gpu_play(int gens, long live[]);
+void Gpu_fetch(uint64_t world[]);
+void Gpu_stop(void);
+#endif
+#ifdef USE_TRACE
+void Trace_setup(void);
+void Trace_thread(int rank);
+int  Perf_open(uint64_t config);
+double Trace_now(void);
+void Trace_span(const char *name, double start, double *total);
+void Trace_report(void);
+#endif
+#ifdef USE_MPI
+void Start_mpi(int *argc_p, char **argv_p[]);
+void Split_world(void);
+void Stop_mpi(void);
+void Start_halo(word_t wp[]);
+void Wait_halo(void);
+void Gather_world(word_t wp[], word_t full[], int view);
+void Scatter_world(word_t full[], word_t wp[]);
+#endif
+
+/* Row i of the packed world wp, -halo <= i < m+halo.  Rows -halo to -1
+ * and m to m+halo-1 are the ghost rows, and words -1 and W of each row
+ * are its ghost words.
+ */
+static inline word_t *Row(word_t wp[], int i) {
+    return wp + (size_t) (i+halo)*pitch + 1;
+}
+
+/* Row i of the torus, for -m <= i < 2*m.  With MPI the rows next to
+ * this process's come from the ghost rows instead, so i has to be
+ * within halo rows of [0, m).
+ */
+static inline const word_t *Torus_row(word_t wp[], int i) {
+#   ifdef USE_MPI
+    return Row(wp, i);
+#   else
+    return Row(wp, i < 0 ? i + m : (i >= m ? i - m : i));
+#   endif
+}
+
+/* Without MPI, when words [first, last) of row 0 or m-1 of a world are
+ * written, so are the ghost rows that copy them.  With MPI the ghost
+ * rows come from the neighboring processes instead (see Start_halo).
+ */
+static inline void Wrap_ghost_rows(word_t wp[], int i, int first,
+      int last) {
+#   ifndef USE_MPI
+    if (i == 0)
+        Copy_to_ghost_row(Row(wp, m), Row(wp, 0), first, last);
+    if (i == m-1)
+        Copy_to_ghost_row(Row(wp, -1), Row(wp, m-1), first, last);
+#   else
+    (void) wp, (void) i, (void) first, (void) last;
+#   endif
+}
+
+/* Cell accessors for the packed world */
+static inline int Get_cell(word_t wp[], int i, int j) {
+    return (Row(wp, i)[j/WORD_BITS] >> (j%WORD_BITS)) & 1;
+}
+
+static inline void Set_cell(word_t wp[], int i, int j, int val) {
+    word_t bit = (word_t) 1 << (j%WORD_BITS);
+
+    if (val == LIVE)
+        Row(wp, i)[j/WORD_BITS] |= bit;
+    else
+        Row(wp, i)[j/WORD_BITS] &= ~bit;
+}
+
+/* The sparse engine's name for cell (i, j) */
+static inline uint64_t Sp_key(int i, int j) {
+    return (uint64_t) i << 32 | (uint32_t) j;
+}
+
+/* A live cell of generation 0:  with -E sparse there's no packed world,
+ * and it goes in the list instead (see Sp_unique)
+ */
+static inline void Put_cell(word_t wp[], int i, int j) {
+    if (wp == NULL)
+        Sp_append(Sp_key(i, j));
+    else
+        Set_cell(wp, i, j, LIVE);
+}
+
+/* Life_parse_text's Life_put_t for Parse_text:  arg is the world */
+static void Put_text_cell(void *arg, int i, int j) {
+    Put_cell(arg, i, j);
+}
+
+/* Whether a cell with count live neighbors is alive next generation */
+static inline int Rule_alive(int count, int alive) {
+    return ((alive ? rule_survive : rule_birth) >> count) & 1;
+}
 
 /*----------------------------------------------------------------------------*/
 int main(int argc, char* argv[]) {
-    int *w1, *w2;
-    char ig;
+    word_t *w1, *w2;
     pthread_t* thread_handles;
+    pthread_attr_t attr;
+    cpu_set_t cpus;
     long thread;
+    struct timespec finish;
     
-    if (argc != 7) Usage(argv[0]);
-    
-    r = strtol(argv[1], NULL, 10);
-    s = strtol(argv[2], NULL, 10);
-    m = strtol(argv[3], NULL, 10);
-    n = strtol(argv[4], NULL, 10);
-    max_gens = strtol(argv[5], NULL, 10);
-    ig = argv[6][0];
-    thread_count = r*s;
+#   ifdef USE_MPI
+    Start_mpi(&argc, &argv);
+#   endif
+    input_char = Get_args(argc, argv);
+    if (bench_format != BENCH_OFF)
+        Bench_sweep(argv[0]);
+    else if (check_file != NULL)
+        Check_sweep();
+    else if (tune_file != NULL)
+        Tune_sweep();
+    /* The other engines run on the main thread */
+    thread_count = engine == ENGINE_CPU || engine == ENGINE_AUTO ? r*s : 1;
+    W = Word_count(n);
+    pitch = (W + 2 + LINE_WORDS - 1)/LINE_WORDS*LINE_WORDS;
+    if (pitch*sizeof(word_t) % 4096 == 0)
+        pitch += LINE_WORDS;
+#   ifdef USE_MPI
+    Split_world();
+#   endif
+    Decompose();
+    Select_kernel();
     
 #  ifdef DEBUG
     printf("r = %d, s = %d, m = %d, n = %d, max_gens = %d, ig = %c\n",
-           r, s, m, n, max_gens, ig);
+           r, s, m, n, max_gens, input_char);
+    printf("kernel = %s\n", kernel_name);
 #  endif
+    if (ens_count > 0) {
+        /* The ensemble's threads play whole worlds (see note 20) */
+        Play_ensemble();
+        return 0;
+    }
     
     pthread_mutex_init(&barrier_mutex, NULL);
     pthread_cond_init(&ok_to_proceed, NULL);
+    /* Spinning only helps if every thread has a core to spin on */
+    barrier_spins =
+          thread_count <= sysconf(_SC_NPROCESSORS_ONLN) ? BARRIER_SPINS : 0;
     thread_handles = malloc(thread_count*sizeof(pthread_t));
-    w1 = malloc(m*n*sizeof(int));
-    w2 = malloc(m*n*sizeof(int));
+    /* Each thread's counts start a cache line of their own */
+    live_stride = (depth + LINE_LONGS - 1)/LINE_LONGS*LINE_LONGS;
+    live_counts = aligned_alloc(CACHE_LINE,
+          thread_count*live_stride*sizeof(long));
+    block_live = malloc(depth*sizeof(long));
+    if (stats_file != NULL) {
+        stats_counts = aligned_alloc(CACHE_LINE,
+              thread_count*live_stride*sizeof(Stats_t));
+        block_stats = malloc(depth*sizeof(Stats_t));
+        tile_stats = malloc(tile_m*tile_n*sizeof(Stats_t));
+        band_live = malloc(depth*tile_m*sizeof(long));
+        if (mpi_rank == 0) {
+            stats_out = fopen(stats_file, "w");
+            if (stats_out == NULL) {
+                fprintf(stderr, "Can't open %s\n", stats_file);
+                exit(1);
+            }
+            /* Lines are written at the barrier, so don't wait on I/O */
+            setvbuf(stats_out, NULL, _IOFBF, 1 << 20);
+            fprintf(stats_out, "gen,live,births,deaths,top,left,bottom,"
+                  "right,empty");
+            for (thread = 1; thread <= STATS_BINS; thread++)
+                fprintf(stats_out, ",d%ld", thread*100/STATS_BINS);
+            fprintf(stats_out, "\n");
+        }
+    }
+    bench_wait = calloc(thread_count, sizeof(double));
+    /* The threads zero the worlds (see note 9) */
+    page_words = World_page(m + 2*halo)/sizeof(word_t);
+    w1 = w2 = NULL;
+    if (restart_file != NULL)
+        w1 = Open_checkpoint(restart_file);
+    /* The sparse engine only has its list of cells (see note 13) */
+    if (engine != ENGINE_SPARSE) {
+        if (w1 == NULL)
+            w1 = Alloc_world(m + 2*halo);
+        w2 = Alloc_world(m + 2*halo);
+    }
     wp = w1;
     twp = w2;
-    
-    if (ig == 'i')
-        Read_world("Enter generation 0", wp, m, n);
-    else
-        Gen_world("What's the prob that a cell is alive?", wp, m, n);
-    
-    printf("\n");
-    Print_world("Generation 0", wp, m, n);
-    
-    for (thread = 0; thread < thread_count; thread++) {
-        pthread_create(&thread_handles[thread], NULL,
-                       Play_life, (void*) thread);
+    /* Every tile has to be computed in generation 1 */
+    changed = malloc(tile_m*tile_n);
+    memset(changed, 1, tile_m*tile_n);
+    next_changed = malloc(tile_m*tile_n);
+    tile_live = malloc(tile_m*tile_n*sizeof(long));
+    tile_hash = calloc(tile_m*tile_n, sizeof(uint64_t));
+    if (cycle_ring > 0) {
+        ring_hash = malloc(cycle_ring*sizeof(uint64_t));
+        ring_gen = malloc(cycle_ring*sizeof(int));
+        memset(ring_gen, -1, cycle_ring*sizeof(int));
     }
+    tile_cost = calloc(tile_m*tile_n, sizeof(double));
+    if (numa_policy != NUMA_OFF)
+        Find_cpus();
+#   ifdef USE_TRACE
+    Trace_setup();
+#   endif
+    
+    if (mpi_rank == 0)
+        Start_writer();
     
-    for (thread = 0; thread < thread_count; thread++) {
-        pthread_join(thread_handles[thread], NULL);
+#   ifdef USE_CUDA
+    if (engine == ENGINE_GPU)
+        Play_gpu();
+    else
+#   endif
+    if (engine == ENGINE_HASHLIFE) {
+        Play_hashlife();
+    } else if (engine == ENGINE_SPARSE) {
+        Play_sparse();
+    } else {
+        for (thread = 0; thread < thread_count; thread++) {
+            pthread_attr_init(&attr);
+            if (thread_cpu != NULL) {
+                CPU_ZERO(&cpus);
+                CPU_SET(thread_cpu[thread], &cpus);
+                pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+            }
+            pthread_create(&thread_handles[thread], &attr,
+                           Play_life, (void*) thread);
+            pthread_attr_destroy(&attr);
+        }
+        
+        for (thread = 0; thread < thread_count; thread++) {
+            pthread_join(thread_handles[thread], NULL);
+        }
     }
+#   ifdef USE_MPI
+    Wait_halo();
+#   endif
+    clock_gettime(CLOCK_MONOTONIC, &finish);
+    if (bench_format == BENCH_CHECK)
+        Check_report(finish);
+    else if (bench_format == BENCH_TUNE)
+        Tune_report(finish);
+    else if (bench_format != BENCH_OFF && mpi_rank == 0)
+        Bench_report(finish);
+    if (out_final || (ckpt_every > 0 && curr_gen % ckpt_every != 0))
+        Queue_snapshot(wp, curr_gen,
+              wp != NULL ? Count_live(wp) : sp_count,
+              (out_final ? SNAP_PRINT : 0)
+              | (ckpt_every > 0 && curr_gen % ckpt_every != 0 ?
+                 SNAP_CHECKPOINT : 0));
+    Sp_stop();
+    if (mpi_rank == 0)
+        Stop_writer();
+#   ifdef USE_TRACE
+    Trace_report();
+#   endif
     
-    free(w1);
-    free(w2);
+    Free_world(w1, m + 2*halo);
+    Free_world(w2, m + 2*halo);
     free(thread_handles);
+    free(live_counts);
+    free(block_live);
+    if (stats_file != NULL) {
+        free(stats_counts);
+        free(block_stats);
+        free(tile_stats);
+        free(band_live);
+        if (mpi_rank == 0) fclose(stats_out);
+    }
+    free(bench_wait);
+    free(changed);
+    free(next_changed);
+    free(tile_live);
+    free(tile_hash);
+    if (cycle_ring > 0) {
+        free(ring_hash);
+        free(ring_gen);
+    }
+    free(tile_cost);
+    free(tile_row0);
+    free(tile_word0);
+    free(deques);
+    free(seed_start);
+    free(thread_cpu);
     pthread_mutex_destroy(&barrier_mutex);
     pthread_cond_destroy(&ok_to_proceed);
+#   ifdef USE_MPI
+    Stop_mpi();
+#   endif
     
-    return 0;
+    return check_status;
 }  /* main */
 
 
@@ -146,227 +1432,5010 @@ int main(int argc, char* argv[]) {
  * In arg:     prog_name
  */
 void Usage(char prog_name[]) {
-    fprintf(stderr, "usage: %s <r> <s> <rows> <cols> <max> <i|g>\n", prog_name);
-    fprintf(stderr, "       r = number of rows of threads\n");
-    fprintf(stderr, "       s = number of columns of threads\n");
+    fprintf(stderr, "usage: %s [options] <r> <s> <rows> <cols> <max> <i|g>\n",
+          prog_name);
+    fprintf(stderr, "     r*s = number of threads\n");
     fprintf(stderr, "    rows = number of rows in the world\n");
     fprintf(stderr, "    cols = number of cols in the world\n");
     fprintf(stderr, "     max = max number of generations\n");
     fprintf(stderr, "       i = user will enter generation 0\n");
     fprintf(stderr, "       g = program should generate generation 0\n");
+    fprintf(stderr, "options:\n");
+    fprintf(stderr, "   -o <all|k|final|none>  generations to print\n");
+    fprintf(stderr, "   -f <ascii|packed|rle|delta[,<k>]>  output format\n");
+    fprintf(stderr, "   -z <lz4|zstd>          compress the delta format\n");
+    fprintf(stderr, "   -H                     header before ascii worlds\n");
+    fprintf(stderr, "   -i <file>              read generation 0 from file\n");
+    fprintf(stderr, "                          (X/space, .rle or .cells)\n");
+    fprintf(stderr, "   -p <row>,<col>         where to put the pattern\n");
+    fprintf(stderr, "   -S <seed>              seed for generating gen 0\n");
+    fprintf(stderr, "   -a                     don't skip unchanged tiles\n");
+    fprintf(stderr, "   -b <gens>              rebalance every gens gens\n");
+    fprintf(stderr, "   -T <rows>,<words>      maximum tile size\n");
+    fprintf(stderr, "   -K <gens>              max gens between barriers\n");
+    fprintf(stderr, "   -N <local|interleave|off>  memory placement\n");
+    fprintf(stderr, "   -E <cpu|sparse|auto|hashlife|gpu>  engine\n");
+    fprintf(stderr, "   -U                     hashlife on the plane\n");
+    fprintf(stderr, "   -m <nodes>             hashlife node limit\n");
+    fprintf(stderr, "   -L <thp|hugetlb|off>   huge pages for the worlds\n");
+    fprintf(stderr, "   -C <gens>              look for cycles up to gens\n");
+    fprintf(stderr, "   -B <csv|json>[,<gens>]  benchmark after gens gens\n");
+    fprintf(stderr, "                          (r, rows, cols may be lists)\n");
+    fprintf(stderr, "   -Q <file>              write a timeline to file\n");
+    fprintf(stderr, "   -c <gens>,<file>       checkpoint every gens gens\n");
+    fprintf(stderr, "   -r <file>              restart from a checkpoint\n");
+    fprintf(stderr, "   -R <row>,<col>,<rows>,<cols>\n");
+    fprintf(stderr, "                          only print this window\n");
+    fprintf(stderr, "   -D <k>                 print counts of k x k blocks\n");
+    fprintf(stderr, "   -u <rule>              rule, like B36/S23\n");
+    fprintf(stderr, "   -M <seeds>[/<probs>]   play an ensemble of worlds\n");
+    fprintf(stderr, "   -s <file>              write stats to file\n");
+    fprintf(stderr, "   -V <file>              check and time the engines\n");
+    fprintf(stderr, "   -A <file>              tune, or use the tuning file\n");
     exit(0);
 }  /* Usage */
 
+
 /*---------------------------------------------------------------------
- * Function:   Read_world
- * Purpose:    Get generation 0 from the user
- * In args:    prompt
- *             m:  number of rows in visible world
- *             n:  number of cols in visible world
- * Out arg:    wp:  stores generation 0
- *
+ * Function:   Get_args
+ * Purpose:    Get the options and the command line args
+ * In args:    argc, argv
+ * Out globals: r, s, m, world_m, n, max_gens, out_every, out_final, out_format,
+ *             delta_every, delta_codec,
+ *             out_header, in_file, in_row, in_col, gen_seed,
+ *             track_active, rebalance_every, tile_rows, tile_words,
+ *             depth, numa_policy, huge_pages, engine, hl_plane,
+ *             hl_max_nodes, cycle_ring, bench_format, bench_warmup,
+ *             bench_threads, bench_rows, bench_cols, prompt_file,
+ *             trace_file, ckpt_every, ckpt_file, restart_file,
+ *             view_whole, view_row, view_col, view_m, view_n, view_scale,
+ *             rule_birth, rule_survive, rule_name, ens_worlds,
+ *             ens_count, ens_prompt, stats_file, check_file,
+ *             tune_file
+ * Ret val:    The input char ('i' or 'g')
  */
-void Read_world(char prompt[], int wp[], int m, int n) {
-    int i, j;
-    char c;
+char Get_args(int argc, char* argv[]) {
+    int c;
+    char *end;
     
-    printf("%s\n", prompt);
-    for (i = 0; i < m; i++) {
-        for (j = 0; j < n; j++) {
-            scanf("%c", &c);
-            if (c == LIVE_IO)
-                wp[i*n + j] = LIVE;
-            else
-                wp[i*n + j] = DEAD;
+    while ((c = getopt(argc, argv,
+                "o:f:Hi:p:S:ab:T:K:N:L:E:Um:C:B:Q:c:r:R:D:u:M:s:z:V:A:"))
+          != -1)
+        switch (c) {
+            case 'o':
+                if (strcmp(optarg, "all") == 0) {
+                    out_every = 1;
+                } else if (strcmp(optarg, "final") == 0) {
+                    out_every = 0;
+                    out_final = 1;
+                } else if (strcmp(optarg, "none") == 0) {
+                    out_every = 0;
+                } else {
+                    out_every = strtol(optarg, NULL, 10);
+                    if (out_every < 1) Usage(argv[0]);
+                }
+                break;
+            case 'f':
+                if (strcmp(optarg, "ascii") == 0)
+                    out_format = FMT_ASCII;
+                else if (strcmp(optarg, "packed") == 0)
+                    out_format = FMT_PACKED;
+                else if (strcmp(optarg, "rle") == 0)
+                    out_format = FMT_RLE;
+                else if (strncmp(optarg, "delta", 5) == 0)
+                    out_format = FMT_DELTA;
+                else
+                    Usage(argv[0]);
+                if (out_format == FMT_DELTA && optarg[5] == ',')
+                    delta_every = strtol(optarg + 6, NULL, 10);
+                else if (out_format == FMT_DELTA && optarg[5] != '\0')
+                    Usage(argv[0]);
+                if (delta_every < 1) Usage(argv[0]);
+                break;
+            case 'z':
+                if (strcmp(optarg, "lz4") == 0) {
+#                   ifndef USE_LZ4
+                    fprintf(stderr, "Compile with USE_LZ4 for -z lz4\n");
+                    exit(1);
+#                   endif
+                    delta_codec = CODEC_LZ4;
+                } else if (strcmp(optarg, "zstd") == 0) {
+#                   ifndef USE_ZSTD
+                    fprintf(stderr, "Compile with USE_ZSTD for -z zstd\n");
+                    exit(1);
+#                   endif
+                    delta_codec = CODEC_ZSTD;
+                } else {
+                    Usage(argv[0]);
+                }
+                break;
+            case 'H':
+                out_header = 1;
+                break;
+            case 'i':
+                in_file = optarg;
+                break;
+            case 'p':
+                if (sscanf(optarg, "%d,%d", &in_row, &in_col) != 2 ||
+                      in_row < 0 || in_col < 0)
+                    Usage(argv[0]);
+                break;
+            case 'S':
+                gen_seed = strtoull(optarg, NULL, 10);
+                break;
+            case 'a':
+                track_active = 0;
+                break;
+            case 'b':
+                rebalance_every = strtol(optarg, NULL, 10);
+                if (rebalance_every < 0) Usage(argv[0]);
+                break;
+            case 'T':
+                if (sscanf(optarg, "%d,%d", &tile_rows, &tile_words) != 2 ||
+                      tile_rows < 1 || tile_words < 1)
+                    Usage(argv[0]);
+                break;
+            case 'K':
+                depth = strtol(optarg, NULL, 10);
+                if (depth < 1) Usage(argv[0]);
+                break;
+            case 'N':
+                if (strcmp(optarg, "local") == 0)
+                    numa_policy = NUMA_LOCAL;
+                else if (strcmp(optarg, "interleave") == 0)
+                    numa_policy = NUMA_INTERLEAVE;
+                else if (strcmp(optarg, "off") == 0)
+                    numa_policy = NUMA_OFF;
+                else
+                    Usage(argv[0]);
+                break;
+            case 'L':
+                if (strcmp(optarg, "thp") == 0)
+                    huge_pages = HUGE_THP;
+                else if (strcmp(optarg, "hugetlb") == 0)
+                    huge_pages = HUGE_TLB;
+                else if (strcmp(optarg, "off") == 0)
+                    huge_pages = HUGE_OFF;
+                else
+                    Usage(argv[0]);
+                break;
+            case 'E':
+                if (strcmp(optarg, "cpu") == 0) {
+                    engine = ENGINE_CPU;
+                } else if (strcmp(optarg, "sparse") == 0) {
+                    engine = ENGINE_SPARSE;
+                } else if (strcmp(optarg, "auto") == 0) {
+                    engine = ENGINE_AUTO;
+                } else if (strcmp(optarg, "hashlife") == 0) {
+                    engine = ENGINE_HASHLIFE;
+                } else if (strcmp(optarg, "gpu") == 0) {
+#                   ifndef USE_CUDA
+                    fprintf(stderr, "Compile with USE_CUDA for -E gpu\n");
+                    exit(1);
+#                   endif
+                    engine = ENGINE_GPU;
+                } else {
+                    Usage(argv[0]);
+                }
+                break;
+            case 'U':
+                hl_plane = 1;
+                break;
+            case 'm':
+                hl_max_nodes = strtol(optarg, NULL, 10);
+                if (hl_max_nodes < 1) Usage(argv[0]);
+                break;
+            case 'C':
+                cycle_ring = strtol(optarg, NULL, 10);
+                if (cycle_ring < 1) Usage(argv[0]);
+                break;
+            case 'B':
+                if (strncmp(optarg, "csv", 3) == 0)
+                    bench_format = BENCH_CSV;
+                else if (strncmp(optarg, "json", 4) == 0)
+                    bench_format = BENCH_JSON;
+                else
+                    Usage(argv[0]);
+                bench_warmup = BENCH_WARMUP;
+                if (strchr(optarg, ',') != NULL)
+                    bench_warmup = strtol(strchr(optarg, ',') + 1, NULL, 10);
+                if (bench_warmup < 0) Usage(argv[0]);
+                break;
+            case 'c':
+                ckpt_every = strtol(optarg, &end, 10);
+                if (ckpt_every < 1 || *end != ',' || end[1] == '\0')
+                    Usage(argv[0]);
+                ckpt_file = end + 1;
+                break;
+            case 'r':
+                restart_file = optarg;
+                break;
+            case 'R':
+                if (sscanf(optarg, "%d,%d,%d,%d", &view_row, &view_col,
+                         &view_m, &view_n) != 4 || view_row < 0
+                      || view_col < 0 || view_m < 1 || view_n < 1)
+                    Usage(argv[0]);
+                view_whole = 0;
+                break;
+            case 'D':
+                view_scale = strtol(optarg, NULL, 10);
+                if (view_scale < 1) Usage(argv[0]);
+                break;
+            case 'u':
+                if (!Parse_rule(optarg)) Usage(argv[0]);
+                break;
+            case 'M':
+                if (!Parse_ensemble(optarg)) Usage(argv[0]);
+                break;
+            case 's':
+                stats_file = optarg;
+                break;
+            case 'V':
+                check_file = optarg;
+                break;
+            case 'A':
+                tune_file = optarg;
+                break;
+            case 'Q':
+#               ifndef USE_TRACE
+                fprintf(stderr, "Compile with USE_TRACE for -Q\n");
+                exit(1);
+#               else
+                trace_file = optarg;
+#               endif
+                break;
+            default:
+                Usage(argv[0]);
         }
-        /* Read end of line character */
-        scanf("%c", &c);
+    if (argc - optind != 6) Usage(argv[0]);
+    if (view_scale > 1 && (out_format == FMT_RLE || out_format == FMT_DELTA)) {
+        fprintf(stderr, "-D doesn't work with -f rle or -f delta\n");
+        exit(1);
     }
-}  /* Read_world */
+    if (delta_codec != CODEC_NONE && out_format != FMT_DELTA) {
+        fprintf(stderr, "-z only compresses -f delta\n");
+        exit(1);
+    }
+    if ((rule_birth & 1) && engine != ENGINE_CPU && engine != ENGINE_AUTO) {
+        fprintf(stderr, "Rules with B0 only run on the cpu engine\n");
+        exit(1);
+    }
+    if (stats_file != NULL && engine != ENGINE_CPU) {
+        fprintf(stderr, "-s only works with the cpu engine\n");
+        exit(1);
+    }
+    /* A checkpoint only holds the packed m x n world (see note 17) */
+    if ((hl_plane || engine == ENGINE_SPARSE)
+          && (ckpt_every > 0 || restart_file != NULL)) {
+        fprintf(stderr, "-c and -r don't work with -U or -E sparse\n");
+        exit(1);
+    }
+    /* The other engines don't hash their worlds (see note 14) */
+    if (cycle_ring > 0 && engine != ENGINE_CPU) {
+        fprintf(stderr, "-C only works with the cpu engine\n");
+        exit(1);
+    }
+#   ifdef USE_MPI
+    if (engine != ENGINE_CPU) {
+        fprintf(stderr, "Only the cpu engine runs under MPI\n");
+        exit(1);
+    }
+#   endif
+    
+    r = strtol(argv[optind], NULL, 10);
+    s = strtol(argv[optind+1], NULL, 10);
+    world_m = strtol(argv[optind+2], NULL, 10);
+    n = strtol(argv[optind+3], NULL, 10);
+    max_gens = strtol(argv[optind+4], NULL, 10);
+    if (r < 1 || s < 1 || world_m < 1 || n < 1) Usage(argv[0]);
+    if (ens_count > 0 && (argv[optind+5][0] != 'g' || in_file != NULL
+          || restart_file != NULL || bench_format != BENCH_OFF
+          || engine != ENGINE_CPU || stats_file != NULL)) {
+        fprintf(stderr, "-M generates its worlds and plays them on the "
+              "cpu engine, without -i, -r, -B or -s\n");
+        exit(1);
+    }
+#   ifdef USE_MPI
+    if (ens_count > 0) {
+        fprintf(stderr, "-M doesn't run under MPI\n");
+        exit(1);
+    }
+#   endif
+    if (check_file != NULL && (argv[optind+5][0] != 'g' || in_file != NULL
+          || restart_file != NULL || bench_format != BENCH_OFF
+          || ens_count > 0 || engine != ENGINE_CPU || stats_file != NULL
+          || ckpt_every > 0 || cycle_ring > 0)) {
+        fprintf(stderr, "-V plays its own worlds on every engine, without "
+              "-i, -r, -B, -M, -E, -s, -c or -C\n");
+        exit(1);
+    }
+    if (tune_file != NULL && (bench_format != BENCH_OFF
+          || check_file != NULL || ens_count > 0
+          || (engine != ENGINE_CPU && engine != ENGINE_AUTO))) {
+        fprintf(stderr, "-A tunes the cpu engine, without -B, -V or -M\n");
+        exit(1);
+    }
+#   ifdef USE_MPI
+    if (tune_file != NULL) {
+        fprintf(stderr, "-A doesn't run under MPI\n");
+        exit(1);
+    }
+#   endif
+    /* Only the ascii worlds can have the prompts mixed in with them */
+    prompt_file = check_file != NULL || out_format != FMT_ASCII ? stderr
+                                                                : stdout;
+    if (check_file != NULL) {
+        out_every = 0;
+        out_final = 0;
+    }
+    if (bench_format != BENCH_OFF) {
+        /* Bench_sweep sets the sizes */
+        bench_threads = argv[optind];
+        bench_rows = argv[optind+2];
+        bench_cols = argv[optind+3];
+        out_every = 0;
+        out_final = 0;
+        max_gens += bench_warmup;
+        prompt_file = stderr;
+    } else {
+        if (strchr(argv[optind], ',') != NULL ||
+              strchr(argv[optind+2], ',') != NULL ||
+              strchr(argv[optind+3], ',') != NULL)
+            Usage(argv[0]);
+        Set_size(world_m, n);
+    }
+    /* A block of generations can't say which tiles changed in its
+     * last generation */
+    if (depth > 1) track_active = 0;
+    
+    /* Generation 0 is the checkpoint's, however it was made */
+    if (restart_file != NULL) return 'i';
+    return argv[optind+5][0];
+}  /* Get_args */
 
 
 /*---------------------------------------------------------------------
- * Function:   Gen_world
- * Purpose:    Use a random number generator to create generation 0
- * In args:    prompt
- *             m:  number of rows in visible world
- *             n:  number of cols in visible world
- * Out arg:    wp:  stores generation 0
+ * Function:   Set_size
+ * Purpose:    Set the size of the world, and check it against the
+ *             options
+ * In args:    rows, cols
+ * In globals: engine, hl_plane, view_whole
+ * Out globals: world_m, m, n
+ * In/out globals: in_row, in_col, view_row, view_col, view_m, view_n
+ */
+void Set_size(int rows, int cols) {
+    world_m = rows;
+    m = world_m;        /* Split_world cuts this down with MPI */
+    n = cols;
+    in_row %= world_m;
+    in_col %= n;
+    if (engine == ENGINE_HASHLIFE && !hl_plane &&
+          ((m & (m-1)) != 0 || (n & (n-1)) != 0)) {
+        fprintf(stderr, "HashLife needs the rows and cols to be powers "
+              "of 2, or -U\n");
+        exit(1);
+    }
+    if (view_whole) {
+        view_row = view_col = 0;
+        view_m = world_m;
+        view_n = n;
+    } else if (view_row + view_m > world_m || view_col + view_n > n) {
+        fprintf(stderr, "The window has to be inside the %d x %d world\n",
+              world_m, n);
+        exit(1);
+    }
+}  /* Set_size */
+
+/*---------------------------------------------------------------------
+ * Function:   Bench_sweep
+ * Purpose:    Run each configuration of a benchmark sweep in a child
+ *             process of its own (see note 15)
+ * In args:    prog_name
+ * In globals: bench_format, bench_threads, bench_rows, bench_cols, s,
+ *             in_file, input_char, mpi_rank, stats_file
+ * Out globals: r, world_m, m, n, generate, gen_threshold
  *
+ * Note:       This only returns in the process that runs a
+ *             configuration:  the child of a sweep, or the process
+ *             itself if there's only one.  Generation 0 is read (or
+ *             its probability is) before forking, so every child
+ *             starts from the same input.
  */
-void Gen_world(char prompt[], int wp[], int m, int n) {
-    int i, j;
-    double prob;
-#  ifdef DEBUG
-    int live_count = 0;
-#  endif
+void Bench_sweep(char prog_name[]) {
+    int threads[BENCH_MAX], rows[BENCH_MAX], cols[BENCH_MAX];
+    int thread_runs, row_runs, col_runs, sizes, i, j, status;
+    pid_t pid;
     
-    printf("%s\n", prompt);
-    scanf("%lf", &prob);
+    thread_runs = Parse_list(bench_threads, threads);
+    row_runs = Parse_list(bench_rows, rows);
+    col_runs = Parse_list(bench_cols, cols);
+    if (thread_runs == 0 || row_runs == 0 || col_runs == 0 ||
+          (row_runs > 1 && col_runs > 1 && row_runs != col_runs))
+        Usage(prog_name);
+    sizes = row_runs > col_runs ? row_runs : col_runs;
     
-    srandom(1);
-    for (i = 0; i < m; i++)
-        for (j = 0; j < n; j++)
-            if (random()/((double) RAND_MAX) <= prob) {
-                wp[i*n + j] = LIVE;
-#           ifdef DEBUG
-                live_count++;
-#           endif
-            } else {
-                wp[i*n + j] = DEAD;
+    if (thread_runs*sizes > 1) {
+#       ifdef USE_MPI
+        fprintf(stderr, "Benchmark sweeps don't run under MPI\n");
+        exit(1);
+#       endif
+        if (in_file == NULL && input_char == 'i') {
+            fprintf(stderr, "A benchmark sweep needs 'g' or -i <file>\n");
+            exit(1);
+        }
+    }
+    if (mpi_rank == 0 && bench_format == BENCH_CSV)
+        printf("engine,kernel,threads,rows,cols,depth,warmup,gens,"
+               "seconds,ns_per_gen,cells_per_sec,barrier_ns_per_gen%s\n",
+               stats_file != NULL ? ",live,births,deaths" : "");
+    if (thread_runs*sizes == 1) {
+        r = threads[0];
+        Set_size(rows[0], cols[0]);
+        return;
+    }
+    if (in_file == NULL)
+        Get_prob("What's the prob that a cell is alive?");
+    
+    for (i = 0; i < sizes; i++)
+        for (j = 0; j < thread_runs; j++) {
+            fflush(stdout);
+            pid = fork();
+            if (pid == 0) {
+                r = threads[j];
+                Set_size(rows[row_runs > 1 ? i : 0],
+                      cols[col_runs > 1 ? i : 0]);
+                return;
+            }
+            if (pid < 0 || waitpid(pid, &status, 0) < 0 ||
+                  !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+                fprintf(stderr, "Benchmark run with %d threads on %d x %d "
+                      "failed\n", threads[j]*s, rows[row_runs > 1 ? i : 0],
+                      cols[col_runs > 1 ? i : 0]);
+                exit(1);
             }
+        }
+    exit(0);
+}  /* Bench_sweep */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Parse_list
+ * Purpose:    Read a comma separated list of positive numbers
+ * In args:    str
+ * Out arg:    list:  room for BENCH_MAX numbers
+ * Ret val:    How many numbers there were, or 0 if str isn't such a
+ *             list
+ */
+int Parse_list(const char str[], int list[]) {
+    int count = 0;
+    char *end;
     
-#  ifdef DEBUG
-    printf("Live count = %d, request prob = %f, actual prob = %f\n",
-           live_count, prob, ((double) live_count)/(m*n));
-#  endif
-}  /* Gen_world */
+    do {
+        if (count == BENCH_MAX) return 0;
+        list[count] = strtol(str, &end, 10);
+        if (end == str || list[count] < 1) return 0;
+        count++;
+        str = end + 1;
+    } while (*end == ',');
+    
+    return *end == '\0' ? count : 0;
+}  /* Parse_list */
 
 
 /*---------------------------------------------------------------------
- * Function:   Print_world
- * Purpose:    Print the current world
- * In args:    title
- *             m:  number of rows in visible world
- *             n:  number of cols in visible world
- *             wp:  current gen
- *
+ * Function:   Bench_report
+ * Purpose:    Print the results of a benchmark run (see note 15)
+ * In globals: bench_format, bench_start, bench_gen0, bench_warmup,
+ *             bench_wait, curr_gen, engine, kernel_name, thread_count,
+ *             world_m, n, depth, stats_file, live_count, stats_births,
+ *             stats_deaths
+ * In args:    finish:  when the run ended
  */
-void Print_world(char title[], int wp[], int m, int n) {
-    int i, j;
+void Bench_report(struct timespec finish) {
+    static const char *engine_names[] =
+          {"cpu", "gpu", "hashlife", "sparse", "auto"};
+    int gens = bench_started ? curr_gen - bench_gen0 : 0;
+    double secs = 0.0, wait = 0.0, per_gen = 0.0, cells = 0.0;
+    int k;
     
-    for (i = 0; i < m; i++) {
-        for (j = 0; j < n; j++)
-            if (wp[i*n + j] == LIVE)
-                printf("%c", LIVE_IO);
-            else
-                printf("%c", DEAD_IO);
-        printf("\n");
+    if (bench_started)
+        secs = (finish.tv_sec - bench_start.tv_sec)
+              + 1.0e-9*(finish.tv_nsec - bench_start.tv_nsec);
+    for (k = 0; k < thread_count; k++)
+        wait += bench_wait[k];
+    if (gens > 0) {
+        per_gen = 1.0e9*secs/gens;
+        cells = (double) world_m*n*gens/secs;
+        wait /= (double) thread_count*gens;
     }
-    printf("%s\n\n", title);
-}  /* Print_world */
+    
+    if (bench_format == BENCH_CSV)
+        printf("%s,%s,%d,%d,%d,%d,%d,%d,%.6f,%.1f,%.4e,%.1f",
+              engine_names[engine], kernel_name, thread_count, world_m, n,
+              depth, bench_warmup, gens, secs, per_gen, cells, wait);
+    else
+        printf("{\"engine\": \"%s\", \"kernel\": \"%s\", \"threads\": %d, "
+              "\"rows\": %d, \"cols\": %d, \"depth\": %d, \"warmup\": %d, "
+              "\"gens\": %d, \"seconds\": %.6f, \"ns_per_gen\": %.1f, "
+              "\"cells_per_sec\": %.4e, \"barrier_ns_per_gen\": %.1f",
+              engine_names[engine], kernel_name, thread_count, world_m, n,
+              depth, bench_warmup, gens, secs, per_gen, cells, wait);
+    /* With -s, the births and deaths in the timed generations */
+    if (stats_file != NULL && bench_format == BENCH_CSV)
+        printf(",%ld,%ld,%ld", live_count, stats_births, stats_deaths);
+    else if (stats_file != NULL)
+        printf(", \"live\": %ld, \"births\": %ld, \"deaths\": %ld",
+              live_count, stats_births, stats_deaths);
+    printf(bench_format == BENCH_CSV ? "\n" : "}\n");
+}  /* Bench_report */
 
 
+/* The worlds -V plays, and how (see note 24) */
+static const Check_case_t check_cases[] = {
+    {"blinker", "XXX", 16, 16, 7, 6, 101, 3, "X\nX\nX", 6, 7},
+    {"glider", " X\n  X\nXXX", 64, 64, 0, 0, 256, 5, " X\n  X\nXXX", 0, 0},
+    {"gun",
+     "                        X\n"
+     "                      X X\n"
+     "            XX      XX            XX\n"
+     "           X   X    XX            XX\n"
+     "XX        X     X   XX\n"
+     "XX        X   X XX    X X\n"
+     "          X     X       X\n"
+     "           X   X\n"
+     "            XX\n", 256, 256, 16, 16, 120, 56, NULL, 0, 0},
+    {"rpent", " XX\nXX\n X", 512, 512, 255, 255, 1103, 116, NULL, 0, 0},
+    {"soup", NULL, 0, 0, 0, 0, 0, -1, NULL, 0, 0}
+};
+#define CHECK_CASES ((int) (sizeof(check_cases)/sizeof(check_cases[0])))
+static const Check_config_t check_configs[] = {
+    {"cpu/%d", ENGINE_CPU, 1, 0, 1, 0, 0},
+    {"cpu/%d", ENGINE_CPU, 0, 0, 1, 0, 0},
+    {"cpu/%d -a", ENGINE_CPU, 0, 0, 0, 0, 0},
+    {"cpu/%d -T 8/1", ENGINE_CPU, 0, 0, 1, 8, 1},
+    {"cpu/%d -K 8", ENGINE_CPU, 0, 8, 0, 0, 0},
+    {"sparse", ENGINE_SPARSE, 1, 0, 1, 0, 0},
+    {"auto/%d", ENGINE_AUTO, 0, 0, 1, 0, 0},
+    {"hashlife", ENGINE_HASHLIFE, 1, 0, 1, 0, 0},
+#   ifdef USE_CUDA
+    {"gpu", ENGINE_GPU, 1, 0, 1, 0, 0},
+#   endif
+};
+#define CHECK_CONFIGS ((int) (sizeof(check_configs)/sizeof(check_configs[0])))
+
 /*---------------------------------------------------------------------
- * Function:     Play_life
- * Purpose:      Play Conway's game of life.  (See header doc)
- * In args:      rank = rank of threads
- * In globals:   max_gens, curr_gen, m, n, r, s, *wp, *twp, break_flag,
- *               live_count
- * Out globals:  *wp
- * Return val:   NULL
+ * Function:   Check_sweep
+ * Purpose:    Play each of the check's worlds on each engine in child
+ *             processes of their own, check the results, and time them
+ *             against the baseline (see note 24)
+ * In globals: check_file, world_m, n, max_gens, r, s, depth,
+ *             tile_rows, tile_words, rule_birth, mpi_size
+ * Out globals: check_case, check_config, check_name, check_fd,
+ *             bench_format, engine, r, s, depth, track_active,
+ *             tile_rows, tile_words, in_row, in_col, max_gens, generate,
+ *             world_m, m, n
+ *
+ * Note:       Like Bench_sweep, this only returns in a child (see
+ *             Fork_run), which plays the world, sends its time back
+ *             from Check_report and exits with status 1 if the world was
+ *             wrong.  The parent exits with status 1 if a run was wrong
+ *             or crashed, and otherwise 2 if one was slow.  Under MPI
+ *             there are no children:  the processes play the soup on
+ *             the cpu engine, and this returns.
  */
-void *Play_life(void* rank) {
-    long myrank = (long) rank;
-    int i, j, count;
-    int my_first_row, my_last_row;
-    int my_first_col, my_last_col;
+void Check_sweep(void) {
+    Check_base_t base[CHECK_MAX], runs[CHECK_MAX];
+    int bases, run_count = 0, wrong = 0, slow = 0, c, k, b, rep, status;
+    int timed;
+    int rows, cols;
+    int soup_rows = world_m, soup_cols = n, soup_gens = max_gens;
+    int threads = r*s, cmd_depth = depth, cmd_tile_rows = tile_rows,
+        cmd_tile_words = tile_words;
+    const Check_config_t *config;
+    const char *result;
+    char config_name[CHECK_NAME/2], last_name[CHECK_NAME/2] = "";
+    double ns_per_gen, best, baseline, spent;
     
-    my_first_row = (myrank/s) * (m/r);
-    my_last_row = my_first_row + m/r;
-    my_first_col = (myrank%s) * (n/s);
-    my_last_col = my_first_col + n/s;
+    if (mpi_rank == 0)
+        printf("case,config,rows,cols,gens,result,ns_per_gen,"
+              "baseline_ns_per_gen\n");
+#   ifdef USE_MPI
+    check_case = &check_cases[CHECK_CASES-1];
+    check_config = &check_configs[1];
+    snprintf(check_name, CHECK_NAME, "soup,cpu/%d*%d,%d,%d,%d", threads,
+          mpi_size, world_m, n, max_gens);
+    bench_format = BENCH_CHECK;
+    return;
+#   endif
     
-    while (curr_gen < max_gens) {
-        for (i = my_first_row; i < my_last_row; i++) {
-            for (j = my_first_col; j < my_last_col; j++) {
-                count = Count_nbhrs(wp, m, n, i, j);
-                
-#               ifdef DEBUG
-                printf("curr_gen = %d, i = %d, j = %d, count = %d\n",
-                       curr_gen, i, j, count);
-#               endif
-                if (count < 2 || count > 3) {
-                    twp[i*n + j] = DEAD;
-                } else if (count == 2) {
-                    twp[i*n + j] = wp[i*n + j];
-                } else {
-                    twp[i*n + j] = LIVE;
+    bases = Read_baseline(base);
+    Get_prob("What's the prob that a cell is alive?");
+    for (c = 0; c < CHECK_CASES; c++) {
+        check_case = &check_cases[c];
+        rows = check_case->rows > 0 ? check_case->rows : soup_rows;
+        cols = check_case->cols > 0 ? check_case->cols : soup_cols;
+        max_gens = check_case->text != NULL ? check_case->gens : soup_gens;
+        in_row = check_case->row;
+        in_col = check_case->col;
+        engine = ENGINE_CPU;
+        Set_size(rows, cols);
+        wrong += Check_known(check_case);
+        
+        for (k = 0; k < CHECK_CONFIGS; k++) {
+            config = &check_configs[k];
+            snprintf(config_name, sizeof(config_name), config->name,
+                  config->threads > 0 ? config->threads : threads);
+            /* With one thread, cpu/1 comes up twice */
+            if (strcmp(config_name, last_name) == 0) continue;
+            strcpy(last_name, config_name);
+            snprintf(check_name, CHECK_NAME, "%.40s,%s,%d,%d,%d",
+                  check_case->name, config_name, rows, cols, max_gens);
+            if (Check_skip(config, rows, cols)) {
+                printf("%s,skip,,\n", check_name);
+                continue;
+            }
+            
+            result = "ok";
+            best = spent = 0.0;
+            for (rep = 0; rep < CHECK_REPEATS || (spent < CHECK_TIME_NS
+                  && rep < CHECK_MAX_REPEATS); rep++) {
+                if (Fork_run(&ns_per_gen, &status) == 0) {
+                    check_config = config;
+                    bench_format = BENCH_CHECK;
+                    engine = config->engine;
+                    r = config->threads > 0 ? config->threads : threads;
+                    s = 1;
+                    depth = config->depth > 0 ? config->depth : cmd_depth;
+                    track_active = depth == 1 && config->track_active;
+                    tile_rows = config->tile_rows > 0 ? config->tile_rows
+                                                      : cmd_tile_rows;
+                    tile_words = config->tile_words > 0 ?
+                          config->tile_words : cmd_tile_words;
+                    generate = check_case->text == NULL;
+                    Set_size(rows, cols);
+                    return;
+                }
+                if (status < 0) {
+                    result = "crashed";
+                    break;
                 }
-                if (twp[i*n + j] == LIVE) {
-                    live_count++;
+                if (status != 0) {
+                    result = "wrong";
+                    break;
                 }
+                if (rep == 0 || ns_per_gen < best) best = ns_per_gen;
+                spent += ns_per_gen*max_gens;
+            }
+            timed = strcmp(result, "ok") == 0;
+            
+            baseline = 0.0;
+            for (b = 0; b < bases; b++)
+                if (strcmp(base[b].name, check_name) == 0)
+                    baseline = base[b].ns_per_gen;
+            if (!timed)
+                wrong++;
+            else if (baseline > 0.0 && best > CHECK_SLACK*baseline &&
+                  best*max_gens >= CHECK_MIN_NS)
+                result = "slow";
+            if (strcmp(result, "slow") == 0) slow++;
+            printf("%s,%s,", check_name, result);
+            if (timed) printf("%.1f", best);
+            printf(",");
+            if (baseline > 0.0) printf("%.1f", baseline);
+            printf("\n");
+            if (timed && run_count < CHECK_MAX) {
+                strcpy(runs[run_count].name, check_name);
+                runs[run_count++].ns_per_gen = best;
             }
-        }
-        
-        Barrier();
-        if (break_flag == 1) {
-            break;
         }
     }
     
-    return NULL;
-}  /* Play_life */
+    if (bases == 0)
+        Write_baseline(runs, run_count);
+    fflush(stdout);
+    fprintf(stderr, "%d wrong, %d slower than the baseline%s\n", wrong, slow,
+          slow > 0 ? " (a warning:  timing can be noisy)" : "");
+    exit(wrong > 0 ? 1 : (slow > 0 ? 2 : 0));
+}  /* Check_sweep */
+
 
 /*---------------------------------------------------------------------
- * Function:   Count_nbhrs
- * Purpose:    Count the number of living nbhrs of the cell (i,j)
- * In args:    wp:  current world
- *             m:   number of rows in world
- *             n:   number of cols in world
- *             i:   row number of current cell
- *             j:   col number of current cell
- * Ret val:    The number of neighboring cells with living neighbors
- *
- * Note:       Since the top row of cells is adjacent to the bottom
- *             row, and since the left col of cells is adjacent to the
- *             right col, in a very small world, it's possible to
- *             count a cell as a neighbor twice.  So we assume that
- *             m and n are at least 3.
+ * Function:   Check_known
+ * Purpose:    Check the library's world against a case's known answer,
+ *             and print its line
+ * In args:    c
+ * In globals: rule_birth, rule_survive, check_name, world_m, n,
+ *             max_gens
+ * Out globals: check_name
+ * Ret val:    1 if the answer is wrong, 0 if it's right or there's no
+ *             answer for the rule
  */
-int Count_nbhrs(int* wp, int m, int n, int i, int j) {
-    int i1, j1, i2, j2;
+int Check_known(const Check_case_t *c) {
+    Life_t *life, *after = NULL;
+    int ok;
+    
+    if (c->live < 0 || rule_birth != CONWAY_BIRTH ||
+          rule_survive != CONWAY_SURVIVE)
+        return 0;
+    life = Check_world(c->text, c->row, c->col, max_gens);
+    ok = Life_live(life) == c->live;
+    if (c->after != NULL) {
+        after = Check_world(c->after, c->after_row, c->after_col, 0);
+        ok = ok && Life_hash(life) == Life_hash(after);
+        Life_destroy(after);
+    }
+    Life_destroy(life);
+    snprintf(check_name, CHECK_NAME, "%.40s,library,%d,%d,%d", c->name,
+          world_m, n, max_gens);
+    printf("%s,%s,,\n", check_name, ok ? "ok" : "wrong");
+    
+    return !ok;
+}  /* Check_known */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Check_skip
+ * Purpose:    Say whether an engine can't play a case's world
+ * In args:    config, rows, cols
+ * In globals: rule_birth
+ * Ret val:    1 if it can't, 0 if it can
+ */
+int Check_skip(const Check_config_t *config, int rows, int cols) {
+    if ((rule_birth & 1) && config->engine != ENGINE_CPU &&
+          config->engine != ENGINE_AUTO)
+        return 1;
+    if (config->engine == ENGINE_HASHLIFE &&
+          ((rows & (rows-1)) != 0 || (cols & (cols-1)) != 0))
+        return 1;
+    return 0;
+}  /* Check_skip */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Check_world
+ * Purpose:    Play a case's world in the library for reference
+ * In args:    text:  generation 0 in the X/space format, or NULL for
+ *                a soup
+ *             row, col:  where the text goes
+ *             gens:  how many generations to play
+ * In globals: world_m, n, rule_name, gen_seed, gen_threshold
+ * Ret val:    The world after gens generations
+ */
+Life_t *Check_world(const char text[], int row, int col, int gens) {
+    Life_t *life;
+    int err;
+    
+    err = Life_create(&life, world_m, n, rule_name, "cpu");
+    if (err != LIFE_OK) {
+        fprintf(stderr, "Can't check the world:  %s\n", Life_strerror(err));
+        exit(1);
+    }
+    if (text == NULL)
+        Life_seed(life, gen_seed, gen_threshold);
+    else
+        Life_load(life, text, strlen(text), row, col);
+    Life_step(life, gens);
+    
+    return life;
+}  /* Check_world */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Read_baseline
+ * Purpose:    Read the times per generation of the runs in the baseline
+ *             file, if there is one
+ * In globals: check_file
+ * Out arg:    base:  room for CHECK_MAX runs
+ * Ret val:    How many runs there were, or 0 if there's no file
+ */
+int Read_baseline(Check_base_t base[]) {
+    FILE *file = fopen(check_file, "r");
+    char line[2*CHECK_NAME], *comma;
     int count = 0;
     
-    for (i1 = i-1; i1 <= i+1; i1++)
-        for (j1 = j-1; j1 <= j+1; j1++) {
-            i2 = (i1 + m) % m;
-            j2 = (j1 + n) % n;
-            count += wp[i2*n + j2];
-        }
-    count -= wp[i*n + j];
+    if (file == NULL) return 0;
+    while (count < CHECK_MAX && fgets(line, sizeof(line), file) != NULL) {
+        comma = strrchr(line, ',');
+        if (comma == NULL || comma - line >= CHECK_NAME ||
+              strncmp(line, "case,", 5) == 0)
+            continue;
+        *comma = '\0';
+        strcpy(base[count].name, line);
+        base[count++].ns_per_gen = strtod(comma + 1, NULL);
+    }
+    fclose(file);
     
     return count;
-}  /* Count_nbhrs */
+}  /* Read_baseline */
+
 
 /*---------------------------------------------------------------------
- * Function:   Barrier
- * Purpose:    Block until all threads have called the barrier
- * In globals: barrier_count, break_flag, live_count
- */
-void Barrier(void) {
-    pthread_mutex_lock(&barrier_mutex);
-    barrier_count++;
-    if (barrier_count == thread_count) {
-        if (live_count == 0) {
-            break_flag = 1;
-        } else {
-            Pointer_swap();
-        }
-        barrier_count = 0;
-        live_count = 0;
-        pthread_cond_broadcast(&ok_to_proceed);
-    } else {
-        while (pthread_cond_wait(&ok_to_proceed, &barrier_mutex) != 0);
+ * Function:   Write_baseline
+ * Purpose:    Write the runs' times per generation to the baseline file
+ * In args:    runs, count
+ * In globals: check_file
+ */
+void Write_baseline(Check_base_t runs[], int count) {
+    FILE *file = fopen(check_file, "w");
+    int k;
+    
+    if (file == NULL) {
+        fprintf(stderr, "Can't write %s\n", check_file);
+        exit(1);
     }
-    pthread_mutex_unlock(&barrier_mutex);
-}
+    fprintf(file, "case,config,rows,cols,gens,ns_per_gen\n");
+    for (k = 0; k < count; k++)
+        fprintf(file, "%s,%.1f\n", runs[k].name, runs[k].ns_per_gen);
+    fclose(file);
+}  /* Write_baseline */
+
 
 /*---------------------------------------------------------------------
- * Function:   Pointer_swap
- * Purpose:    Swaps pointers for generations
- * In globals: curr_gen, m, n
- * In/out:     *wp, *twp
+ * Function:   Check_report
+ * Purpose:    Check a -V run's world against the library's, and send
+ *             the run's time to Check_sweep (see note 24)
+ * In args:    finish:  when the run ended
+ * In globals: wp, curr_gen, max_gens, check_case, check_name,
+ *             check_fd, in_row, in_col, mpi_rank
+ * Out globals: check_status
+ * In/out globals: sp_cells:  with -E sparse wp is NULL, and the
+ *                count and hash come from the list
  *
+ * Note:       With MPI every process has to call this, and process 0
+ *             prints the run's line itself.
  */
-void Pointer_swap(void) {
-    int *tmp;
-    char title[MAX_TITLE];
+void Check_report(struct timespec finish) {
+    long live = wp != NULL ? Count_live(wp) : sp_count;
+    uint64_t hash = wp != NULL ? World_hash(wp) : Sp_hash();
+    double ns_per_gen = Timed_ns_per_gen(finish);
+    Life_t *life;
     
-    tmp = wp;
-    wp = twp;
-    twp = tmp;
-    curr_gen++;
-    sprintf(title, "Generation %d", curr_gen);
-    Print_world(title, wp, m, n);
-}
+    if (mpi_rank != 0) return;
+    life = Check_world(check_case->text, in_row, in_col, max_gens);
+    /* A world that died can stop before max_gens */
+    if (live != Life_live(life) || hash != Life_hash(life) ||
+          (curr_gen != max_gens && live != 0))
+        check_status = 1;
+    Life_destroy(life);
+    
+    if (check_fd < 0)
+        printf("%s,%s,%.1f,\n", check_name,
+              check_status == 0 ? "ok" : "wrong", ns_per_gen);
+    else if (write(check_fd, &ns_per_gen, sizeof(ns_per_gen))
+          != sizeof(ns_per_gen))
+        check_status = 1;
+}  /* Check_report */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Fork_run
+ * Purpose:    Start a child process for a -V or -A run, and wait for it
+ *             to finish
+ * Out args:   ns_per_gen:  the child's time per generation, or -1 if it
+ *                didn't send one
+ *             status:  its exit status, or -1 if it crashed
+ * Out global: check_fd
+ * Ret val:    0 in the child, which sets up its run and returns to
+ *             main;  the child's pid in the parent
+ *
+ * Note:       The child sends its time through a pipe, from
+ *             Check_report or Tune_report.
+ */
+pid_t Fork_run(double *ns_per_gen, int *status) {
+    int fds[2], wait_status;
+    pid_t pid;
+    
+    fflush(stdout);
+    if (pipe(fds) != 0 || (pid = fork()) < 0) {
+        fprintf(stderr, "Can't start a child process\n");
+        exit(1);
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        check_fd = fds[1];
+        return 0;
+    }
+    
+    close(fds[1]);
+    if (read(fds[0], ns_per_gen, sizeof(*ns_per_gen)) != sizeof(*ns_per_gen))
+        *ns_per_gen = -1.0;
+    close(fds[0]);
+    if (waitpid(pid, &wait_status, 0) < 0 || !WIFEXITED(wait_status) ||
+          *ns_per_gen < 0.0)
+        *status = -1;
+    else
+        *status = WEXITSTATUS(wait_status);
+    return pid;
+}  /* Fork_run */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Timed_ns_per_gen
+ * Purpose:    Find the time per generation since the benchmark's clock
+ *             started
+ * In args:    finish:  when the run ended
+ * In globals: bench_started, bench_gen0, bench_start, curr_gen
+ * Ret val:    ns per generation, or 0 if no generations were timed
+ */
+double Timed_ns_per_gen(struct timespec finish) {
+    int gens = bench_started ? curr_gen - bench_gen0 : 0;
+    
+    if (gens <= 0) return 0.0;
+    return (1.0e9*(finish.tv_sec - bench_start.tv_sec)
+          + (finish.tv_nsec - bench_start.tv_nsec))/gens;
+}  /* Timed_ns_per_gen */
+
+
+/* What -A tries for the tiles and -K (see note 25) */
+static const int tune_tiles[][2] =
+      {{TILE_ROWS, TILE_WORDS}, {8, 8}, {128, 8}, {32, 2}, {32, 64}};
+#define TUNE_TILES ((int) (sizeof(tune_tiles)/sizeof(tune_tiles[0])))
+static const int tune_depths[] = {1, 4, 16};
+#define TUNE_DEPTHS ((int) (sizeof(tune_depths)/sizeof(tune_depths[0])))
+
+/*---------------------------------------------------------------------
+ * Function:   Tune_sweep
+ * Purpose:    Choose the threads, kernel, tiles and -K for the world,
+ *             from the tuning file or by timing short runs of it (see
+ *             note 25)
+ * In globals: tune_file, world_m, n, rule_name, tile_rows, tile_words,
+ *             in_file, restart_file, input_char
+ * In/out globals: track_active
+ * Out globals: r, s, kernel_isa, tile_rows, tile_words, depth, and in
+ *             a child bench_format, bench_warmup, max_gens, out_every,
+ *             out_final, ckpt_every, cycle_ring, stats_file,
+ *             trace_file, prompt_file, input_char, generate,
+ *             gen_threshold
+ *
+ * Note:       This returns in the parent once it's tuned, and in each
+ *             child (see Fork_run), which plays the world for
+ *             TUNE_WARMUP + TUNE_GENS generations and sends its time
+ *             from Tune_report.
+ */
+void Tune_sweep(void) {
+    Tune_t best, cand[TUNE_CANDS];
+    char host[64];
+    int stage, count, k, status, from_stdin, cmd_track = track_active;
+    double ns_per_gen;
+    
+    if (gethostname(host, sizeof(host)) != 0) strcpy(host, "unknown");
+    host[sizeof(host) - 1] = '\0';
+    if (Read_tuning(host, &best)) {
+        Tune_apply(&best);
+        track_active = cmd_track && depth == 1;
+        return;
+    }
+    /* The children can't read stdin, so they play a soup instead */
+    from_stdin = in_file == NULL && restart_file == NULL &&
+          input_char == 'i';
+    if (in_file == NULL && restart_file == NULL && input_char == 'g')
+        Get_prob("What's the prob that a cell is alive?");
+    
+    best.threads = 1;
+    best.isa = Life_widest_isa();
+    best.tile_rows = tile_rows;
+    best.tile_words = tile_words;
+    best.depth = 1;
+    best.ns_per_gen = -1.0;
+    for (stage = 0; stage < TUNE_STAGES; stage++) {
+        count = Tune_candidates(stage, &best, cand);
+        for (k = 0; k < count; k++) {
+            if (Fork_run(&ns_per_gen, &status) == 0) {
+                Tune_apply(&cand[k]);
+                track_active = cmd_track && depth == 1;
+                bench_format = BENCH_TUNE;
+                bench_warmup = TUNE_WARMUP;
+                max_gens = TUNE_WARMUP + TUNE_GENS;
+                out_every = 0;
+                out_final = 0;
+                ckpt_every = 0;
+                cycle_ring = 0;
+                stats_file = NULL;
+#               ifdef USE_TRACE
+                trace_file = NULL;
+#               endif
+                /* The children's prompts go nowhere */
+                prompt_file = fopen("/dev/null", "w");
+                if (prompt_file == NULL) prompt_file = stderr;
+                if (from_stdin) {
+                    input_char = 'g';
+                    generate = 1;
+                    gen_threshold = Life_prob_threshold(TUNE_PROB);
+                }
+                return;
+            }
+            if (status == 0 && (best.ns_per_gen < 0.0 ||
+                  ns_per_gen < best.ns_per_gen)) {
+                best = cand[k];
+                best.ns_per_gen = ns_per_gen;
+            }
+        }
+    }
+    if (best.ns_per_gen < 0.0) {
+        fprintf(stderr, "None of the tuning runs finished\n");
+        exit(1);
+    }
+    
+    Tune_apply(&best);
+    track_active = cmd_track && depth == 1;
+    Write_tuning(host, &best);
+    fprintf(stderr, "Tuned for %d x %d:  %d threads, %s kernel, %d x %d "
+          "tiles, -K %d (%.1f ns per gen)\n", world_m, n, best.threads,
+          Life_isa_name(best.isa), best.tile_rows, best.tile_words, best.depth,
+          best.ns_per_gen);
+}  /* Tune_sweep */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Tune_candidates
+ * Purpose:    List the configurations to try at a stage of the tuning:
+ *             the best so far with one thing changed
+ * In args:    stage:  0 for the threads, 1 the kernel, 2 the tiles and
+ *                3 the depth
+ *             best:  the best so far
+ * Out arg:    cand:  room for TUNE_CANDS
+ * Ret val:    How many there are
+ *
+ * Note:       The best so far is left out once it's been timed.  The
+ *             threads are powers of 2 up to the number of CPUs we may
+ *             run on, and that number.
+ */
+int Tune_candidates(int stage, const Tune_t *best, Tune_t cand[]) {
+    cpu_set_t allowed;
+    int cpus = 1, count = 0, k, widest = Life_widest_isa();
+    
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0)
+        cpus = CPU_COUNT(&allowed);
+    for (k = 0; count < TUNE_CANDS; k++) {
+        cand[count] = *best;
+        cand[count].ns_per_gen = -1.0;
+        if (stage == 0 && (1 << k) < cpus)
+            cand[count].threads = 1 << k;
+        else if (stage == 0 && (k == 0 || (1 << (k-1)) < cpus))
+            cand[count].threads = cpus;
+        else if (stage == 1 && k <= widest)
+            cand[count].isa = k;
+        else if (stage == 2 && k < TUNE_TILES) {
+            cand[count].tile_rows = tune_tiles[k][0];
+            cand[count].tile_words = tune_tiles[k][1];
+        } else if (stage == 3 && k < TUNE_DEPTHS)
+            cand[count].depth = tune_depths[k];
+        else
+            break;
+        if (best->ns_per_gen < 0.0 || cand[count].threads != best->threads
+              || cand[count].isa != best->isa
+              || cand[count].tile_rows != best->tile_rows
+              || cand[count].tile_words != best->tile_words
+              || cand[count].depth != best->depth)
+            count++;
+    }
+    
+    return count;
+}  /* Tune_candidates */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Tune_apply
+ * Purpose:    Play the world with a configuration
+ * In args:    tune
+ * Out globals: r, s, kernel_isa, tile_rows, tile_words, depth
+ */
+void Tune_apply(const Tune_t *tune) {
+    r = tune->threads;
+    s = 1;
+    kernel_isa = tune->isa;
+    tile_rows = tune->tile_rows;
+    tile_words = tune->tile_words;
+    depth = tune->depth;
+}  /* Tune_apply */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Read_tuning
+ * Purpose:    Look for this host, world size and rule in the tuning file
+ * In args:    host
+ * In globals: tune_file, world_m, n, rule_name
+ * Out arg:    tune
+ * Ret val:    1 if it's there, 0 if not
+ *
+ * Note:       If the file has more than one line for them, the last one
+ *             is used.  A line for a kernel this CPU can't run is
+ *             skipped.
+ */
+int Read_tuning(const char host[], Tune_t *tune) {
+    FILE *file = fopen(tune_file, "r");
+    char line[256], line_host[64], rule[24], kernel[16];
+    int rows, cols, found = 0, isa;
+    Tune_t t;
+    
+    if (file == NULL) return 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        if (sscanf(line, "%63[^,],%d,%d,%23[^,],%d,%15[^,],%d,%d,%d,%lf",
+              line_host, &rows, &cols, rule, &t.threads, kernel,
+              &t.tile_rows, &t.tile_words, &t.depth, &t.ns_per_gen) != 10
+              || strcmp(line_host, host) != 0 || rows != world_m
+              || cols != n || strcmp(rule, rule_name) != 0
+              || t.threads < 1 || t.tile_rows < 1 || t.tile_words < 1
+              || t.depth < 1)
+            continue;
+        for (isa = Life_widest_isa(); isa >= 0; isa--)
+            if (strcmp(kernel, Life_isa_name(isa)) == 0) break;
+        if (isa < 0) continue;
+        t.isa = isa;
+        *tune = t;
+        found = 1;
+    }
+    fclose(file);
+    
+    return found;
+}  /* Read_tuning */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Write_tuning
+ * Purpose:    Add the tuning for this host, world size and rule to the
+ *             tuning file
+ * In args:    host, tune
+ * In globals: tune_file, world_m, n, rule_name
+ */
+void Write_tuning(const char host[], const Tune_t *tune) {
+    FILE *file = fopen(tune_file, "a");
+    
+    if (file == NULL) {
+        fprintf(stderr, "Can't write %s\n", tune_file);
+        exit(1);
+    }
+    if (ftell(file) == 0)
+        fprintf(file, "host,rows,cols,rule,threads,kernel,tile_rows,"
+              "tile_words,depth,ns_per_gen\n");
+    fprintf(file, "%s,%d,%d,%s,%d,%s,%d,%d,%d,%.1f\n", host, world_m, n,
+          rule_name, tune->threads, Life_isa_name(tune->isa), tune->tile_rows,
+          tune->tile_words, tune->depth, tune->ns_per_gen);
+    fclose(file);
+}  /* Write_tuning */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Tune_report
+ * Purpose:    Send a tuning run's time to Tune_sweep
+ * In args:    finish:  when the run ended
+ * In globals: check_fd
+ */
+void Tune_report(struct timespec finish) {
+    double ns_per_gen = Timed_ns_per_gen(finish);
+    
+    if (write(check_fd, &ns_per_gen, sizeof(ns_per_gen))
+          != sizeof(ns_per_gen))
+        exit(1);
+}  /* Tune_report */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Find_cpus
+ * Purpose:    Choose a CPU for each thread to be pinned to
+ * In globals: thread_count
+ * Out globals: thread_cpu
+ *
+ * Note:       Thread k gets the k-th CPU the program may run on.  If
+ *             there are fewer CPUs than threads, the threads aren't
+ *             pinned, and thread_cpu is left NULL.
+ */
+void Find_cpus(void) {
+    cpu_set_t allowed;
+    int cpu, k = 0;
+    
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 ||
+          CPU_COUNT(&allowed) < thread_count)
+        return;
+    thread_cpu = malloc(thread_count*sizeof(int));
+    for (cpu = 0; cpu < CPU_SETSIZE && k < thread_count; cpu++)
+        if (CPU_ISSET(cpu, &allowed))
+            thread_cpu[k++] = cpu;
+}  /* Find_cpus */
+
+
+/*---------------------------------------------------------------------
+ * Function:   First_touch
+ * Purpose:    Zero a thread's part of a world, so that its pages are
+ *             placed according to numa_policy (see note 9)
+ * In args:    my_rank
+ * Out arg:    buf:  a world from Alloc_world(m + 2*halo)
+ * In globals: m, halo, pitch, thread_count, numa_policy, page_words
+ *
+ * Note:       With NUMA_LOCAL and NUMA_OFF thread 0 also zeroes ghost
+ *             rows above row 0, and the last thread those below row
+ *             m-1.  Pages are
+ *             counted from the start of the mapping, WORLD_LEAD words
+ *             before buf.  A world mapped from a checkpoint is left
+ *             alone (see note 17).
+ */
+void First_touch(word_t buf[], long my_rank) {
+    word_t *base = buf - WORLD_LEAD;
+    size_t words = (size_t) (m + 2*halo)*pitch + WORLD_LEAD;
+    size_t first, last, p;
+    
+    if (buf == mapped_world) return;    /* It's the restart's world */
+    if (numa_policy == NUMA_INTERLEAVE) {
+        for (p = my_rank*page_words; p < words;
+              p += thread_count*page_words)
+            memset(base + p, 0, (words - p < page_words ? words - p
+                  : page_words)*sizeof(word_t));
+    } else {
+        first = my_rank == 0 ? 0
+              : WORLD_LEAD + (my_rank*m/thread_count + halo)*pitch;
+        last = my_rank == thread_count - 1 ? words
+              : WORLD_LEAD + ((my_rank+1)*m/thread_count + halo)*pitch;
+        memset(base + first, 0, (last - first)*sizeof(word_t));
+    }
+}  /* First_touch */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Alloc_world
+ * Purpose:    Allocate a world buffer (see note 2)
+ * In args:    rows:  number of rows of pitch words, counting any
+ *             ghost rows
+ * In globals: pitch, huge_pages
+ * Ret val:    The buffer, with word 1 of each row on a cache line
+ *             boundary.  It's all zero, and none of its pages have
+ *             been touched.
+ *
+ * Note:       With HUGE_TLB the buffer comes from the huge page pool
+ *             if there's room in it.  Otherwise, unless huge pages are
+ *             off, the kernel is asked to back it with transparent
+ *             huge pages.
+ */
+word_t *Alloc_world(size_t rows) {
+    size_t bytes = World_bytes(rows);
+    void *base = MAP_FAILED;
+    
+#   ifdef MAP_HUGETLB
+    if (huge_pages == HUGE_TLB && World_page(rows) == HUGE_PAGE)
+        base = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#   endif
+    if (base == MAP_FAILED) {
+        base = mmap(NULL, bytes, PROT_READ | PROT_WRITE,
+              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (base == MAP_FAILED) {
+            fprintf(stderr, "Can't allocate %zu bytes\n", bytes);
+            exit(1);
+        }
+#       ifdef MADV_HUGEPAGE
+        if (huge_pages != HUGE_OFF)
+            madvise(base, bytes, MADV_HUGEPAGE);
+#       endif
+    }
+    
+    return (word_t*) base + WORLD_LEAD;
+}  /* Alloc_world */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Free_world
+ * Purpose:    Free a buffer from Alloc_world
+ * In args:    buf, rows:  as passed to Alloc_world
+ */
+void Free_world(word_t buf[], size_t rows) {
+    if (buf != NULL)
+        munmap(buf - WORLD_LEAD, World_bytes(rows));
+}  /* Free_world */
+
+
+/*---------------------------------------------------------------------
+ * Function:   World_bytes
+ * Purpose:    Find the size of the mapping Alloc_world makes
+ * In args:    rows
+ * In globals: pitch
+ * Ret val:    rows*pitch words plus WORLD_LEAD, rounded up to a page
+ */
+size_t World_bytes(size_t rows) {
+    size_t page = World_page(rows);
+    
+    return ((rows*pitch + WORLD_LEAD)*sizeof(word_t) + page - 1)/page*page;
+}  /* World_bytes */
+
+
+/*---------------------------------------------------------------------
+ * Function:   World_page
+ * Purpose:    Find the size of the pages backing a world buffer
+ * In args:    rows
+ * In globals: pitch, huge_pages
+ * Ret val:    HUGE_PAGE for buffers of at least a huge page unless
+ *             huge pages are off, the ordinary page size otherwise
+ */
+size_t World_page(size_t rows) {
+    if (huge_pages != HUGE_OFF && rows*pitch*sizeof(word_t) >= HUGE_PAGE)
+        return HUGE_PAGE;
+    return sysconf(_SC_PAGESIZE);
+}  /* World_page */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Get_world
+ * Purpose:    Read generation 0, or get ready to generate it, once
+ *             all the threads have zeroed their parts of the world
+ * In globals: in_file, input_char, world_m, n, mpi_rank, check_case
+ * Out globals: *wp, or sp_cells and sp_count with -E sparse
+ *
+ * Note:       With MPI process 0 reads the whole world into a buffer
+ *             of its own and scatters it, or reads the probability and
+ *             broadcasts it.
+ */
+void Get_world(void) {
+    word_t *full = wp;
+    
+#   ifdef USE_MPI
+    full = NULL;
+    if (mpi_rank == 0 && (in_file != NULL || input_char == 'i'))
+        full = Alloc_world(world_m + 2*halo);
+#   endif
+    if (mpi_rank == 0) {
+        if (restart_file != NULL) {
+            if (full != mapped_world)
+                Read_checkpoint(restart_file, full);
+        } else if (in_file != NULL)
+            Load_world(in_file, full);
+        else if (check_case != NULL && check_case->text != NULL)
+            Parse_text(check_case->text, strlen(check_case->text), full, 0);
+        else if (input_char == 'i')
+            Read_world("Enter generation 0", full, world_m);
+        else if (!generate)     /* Bench_sweep may have asked already */
+            Get_prob("What's the prob that a cell is alive?");
+        
+        fprintf(prompt_file, "\n");
+    }
+#   ifdef USE_MPI
+    if (in_file != NULL || input_char == 'i') {
+        Scatter_world(full, wp);
+        Free_world(full, world_m + 2*halo);
+    } else {
+        MPI_Bcast(&gen_threshold, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+        generate = 1;
+    }
+#   endif
+}  /* Get_world */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Read_world
+ * Purpose:    Get generation 0 from the user
+ * In args:    prompt
+ *             m:  number of rows in visible world
+ * Out arg:    wp:  stores generation 0.  It should be all dead.
+ *
+ * Note:       The m lines are read into one buffer with getline and
+ *             then parsed together.  Parse_text wraps lines longer
+ *             than the world's n cols.
+ */
+void Read_world(char prompt[], word_t wp[], int m) {
+    int i;
+    char *line = NULL, *buf = NULL;
+    size_t line_size = 0, len = 0, buf_size = 0;
+    ssize_t line_len;
+    
+    fprintf(prompt_file, "%s\n", prompt);
+    for (i = 0; i < m; i++) {
+        line_len = getline(&line, &line_size, stdin);
+        if (line_len <= 0) break;
+        if (len + line_len > buf_size) {
+            buf_size = 2*(len + line_len);
+            buf = realloc(buf, buf_size);
+        }
+        memcpy(buf + len, line, line_len);
+        len += line_len;
+    }
+    Parse_text(buf, len, wp, 0);
+    free(line);
+    free(buf);
+}  /* Read_world */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Load_world
+ * Purpose:    Read generation 0 from a file.  The file is mapped into
+ *             memory and parsed in place.
+ * In args:    file:  name of the file
+ * Out arg:    wp:  stores generation 0.  It should be all dead.
+ *
+ * Note:       Files ending in .rle are parsed as RLE and files ending
+ *             in .cells as plaintext.  Other files are RLE if their
+ *             first line that isn't a # comment starts with 'x',
+ *             plaintext if the file starts with '!', and otherwise
+ *             they're in our X/space format.
+ */
+void Load_world(char file[], word_t wp[]) {
+    int fd;
+    struct stat st;
+    const char *buf, *p, *end;
+    size_t len, name_len = strlen(file);
+    
+    fd = open(file, O_RDONLY);
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Can't open %s\n", file);
+        exit(1);
+    }
+    len = st.st_size;
+    if (len == 0) {
+        close(fd);
+        return;
+    }
+    buf = mmap(NULL, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (buf == MAP_FAILED) {
+        fprintf(stderr, "Can't map %s\n", file);
+        exit(1);
+    }
+    madvise((void*) buf, len, MADV_SEQUENTIAL);
+    
+    if (name_len > 4 && strcmp(file + name_len - 4, ".rle") == 0) {
+        Parse_rle(buf, len, wp);
+    } else if (name_len > 6 && strcmp(file + name_len - 6, ".cells") == 0) {
+        Parse_text(buf, len, wp, 1);
+    } else if (buf[0] == '!') {
+        Parse_text(buf, len, wp, 1);
+    } else {
+        /* Look for an RLE header line before the first data line */
+        end = buf + len;
+        Skip_rle_header(buf, end, &p);
+        if (p != NULL)
+            Parse_rle(buf, len, wp);
+        else
+            Parse_text(buf, len, wp, 0);
+    }
+    
+    munmap((void*) buf, len);
+    close(fd);
+}  /* Load_world */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Parse_text
+ * Purpose:    Parse a pattern with one line per row and one char per
+ *             cell, and put it at (in_row, in_col)
+ * In args:    buf, len:  the text
+ *             is_cells:  1 for the plaintext (.cells) format, in which
+ *                live cells are 'O' (or '*');  0 for our format, in
+ *                which live cells are LIVE_IO
+ * Out arg:    wp:  or NULL for the sparse engine's list (see Put_cell)
+ * In globals: world_m, n, in_row, in_col
+ *
+ * Note:       This is the library's Life_parse_text, the loader that
+ *             Life_load uses too.  In both formats lines starting with
+ *             '!' are skipped.  Rows past the last one come back to
+ *             row 0, and so do the cols of long lines.
+ */
+void Parse_text(const char buf[], size_t len, word_t wp[], int is_cells) {
+    static const char live_io[] = {LIVE_IO, '\0'};
+    
+    Life_parse_text(buf, len, world_m, n, in_row, in_col,
+          is_cells ? "O*" : live_io, Put_text_cell, wp);
+}  /* Parse_text */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Parse_rle
+ * Purpose:    Parse a run length encoded pattern, and put it at
+ *             (in_row, in_col)
+ * In args:    buf, len:  the text of the pattern
+ * Out arg:    wp:  or NULL for the sparse engine's list (see Put_cell)
+ * In globals: world_m, n, in_row, in_col
+ *
+ * Note:       Blank lines, # lines and the "x = ..., y = ..." header
+ *             before the data are skipped;  the size of the world comes
+ *             from the command line, and a rule in the header that
+ *             isn't the one being played is warned about.  'b' and '.'
+ *             are dead cells, and any other letter is a live cell.
+ *             Whitespace (including '\r') is ignored.
+ */
+void Parse_rle(const char buf[], size_t len, word_t wp[]) {
+    const char *end = buf + len, *header, *p;
+    int i = in_row, j = in_col;
+    long count, k;
+    
+    p = Skip_rle_header(buf, end, &header);
+    if (header != NULL)
+        Check_rle_rule(header, end);
+    
+    while (p < end && *p != '!') {
+        count = 0;
+        while (p < end && *p >= '0' && *p <= '9')
+            count = 10*count + (*p++ - '0');
+        if (p == end) break;
+        if (count == 0) count = 1;
+        if (*p == '$') {
+            i = (i + count) % world_m;
+            j = in_col;
+        } else if (*p == 'b' || *p == '.') {
+            j = (j + count) % n;
+        } else if ((*p >= 'a' && *p <= 'z') || (*p >= 'A' && *p <= 'Z')) {
+            for (k = 0; k < count; k++) {
+                Put_cell(wp, i, j);
+                if (++j == n) j = 0;
+            }
+        }
+        p++;
+    }
+}  /* Parse_rle */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Skip_rle_header
+ * Purpose:    Find the first data line of an RLE pattern
+ * In args:    p, end:  the text of the pattern
+ * Out arg:    header:  the "x = ..." line, or NULL if there isn't one
+ *             before the data
+ * Ret val:    The first char of the first line that isn't blank, a #
+ *             comment or the header, or end
+ */
+const char *Skip_rle_header(const char *p, const char *end,
+      const char **header) {
+    const char *q, *r, *eol;
+    
+    *header = NULL;
+    while (p < end) {
+        eol = memchr(p, '\n', end - p);
+        if (eol == NULL) eol = end;
+        for (q = p; q < eol && (*q == ' ' || *q == '\t' || *q == '\r'); q++)
+            ;
+        if (q < eol && *q == 'x') {
+            for (r = q + 1; r < eol && (*r == ' ' || *r == '\t'); r++)
+                ;
+            if (r < eol && *r == '=') {
+                *header = q;
+                q = eol;
+            }
+        }
+        if (q < eol && *q != '#') return q;
+        p = eol < end ? eol + 1 : end;
+    }
+    return end;
+}  /* Skip_rle_header */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Check_rle_rule
+ * Purpose:    Warn if the rule in an RLE header isn't the one being
+ *             played
+ * In args:    header:  the "x = ..." line
+ *             end:  the end of the text
+ * In globals: rule_birth, rule_survive, rule_name
+ *
+ * Note:       The rule can be in B/S notation, with an optional
+ *             :<topology> after it that's ignored, or S/B, like 23/3.
+ *             A pattern without a rule is B3/S23.
+ */
+void Check_rle_rule(const char header[], const char *end) {
+    const char *p, *eol = memchr(header, '\n', end - header);
+    char rule[32], bs[40], *slash;
+    int len = 0, birth = CONWAY_BIRTH, survive = CONWAY_SURVIVE;
+    
+    if (eol == NULL) eol = end;
+    for (p = header; p + 4 <= eol && strncmp(p, "rule", 4) != 0; p++)
+        ;
+    if (p + 4 <= eol) {
+        for (p += 4; p < eol && (*p == ' ' || *p == '\t' || *p == '='); p++)
+            ;
+        while (p < eol && len < (int) sizeof(rule) - 1 && *p != ','
+              && *p != ':' && *p != ' ' && *p != '\t' && *p != '\r')
+            rule[len++] = *p++;
+    }
+    rule[len] = '\0';
+    if (len > 0 && Life_parse_rule(rule, &birth, &survive) != LIFE_OK) {
+        /* S/B notation */
+        slash = strchr(rule, '/');
+        if (slash != NULL) {
+            *slash = '\0';
+            snprintf(bs, sizeof(bs), "B%s/S%s", slash + 1, rule);
+            *slash = '/';
+        }
+        if (slash == NULL || strspn(rule, "012345678/") != strlen(rule)
+              || Life_parse_rule(bs, &birth, &survive) != LIFE_OK) {
+            fprintf(stderr, "Can't read the pattern's rule %s;  playing "
+                  "%s\n", rule, rule_name);
+            return;
+        }
+    }
+    if (birth != rule_birth || survive != rule_survive)
+        fprintf(stderr, "The pattern's rule is %s, but %s is being played "
+              "(see -u)\n", len > 0 ? rule : "B3/S23", rule_name);
+}  /* Check_rle_rule */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Get_prob
+ * Purpose:    Ask for the probability that a cell in generation 0 is
+ *             alive, and set things up for the threads to generate it
+ * In args:    prompt
+ * Out globals: generate, gen_threshold
+ */
+void Get_prob(char prompt[]) {
+    double prob;
+    
+    fprintf(prompt_file, "%s\n", prompt);
+    scanf("%lf", &prob);
+    
+    generate = 1;
+    gen_threshold = Life_prob_threshold(prob);
+}  /* Get_prob */
+
+
+/*---------------------------------------------------------------------
+ * Functions:  Stats_clear, Stats_merge
+ * Purpose:    Start the stats of a part of a world, and add the stats
+ *             of another part to them (see note 22)
+ * In arg:     from
+ * In/out arg: stats, into
+ */
+static inline void Stats_clear(Stats_t *stats) {
+    stats->births = stats->deaths = 0;
+    stats->box[0] = stats->box[1] = stats->box[2] = stats->box[3] = INT_MAX;
+}  /* Stats_clear */
+
+static inline void Stats_merge(Stats_t *into, const Stats_t *from) {
+    int k;
+    
+    into->births += from->births;
+    into->deaths += from->deaths;
+    for (k = 0; k < 4; k++)
+        if (from->box[k] < into->box[k]) into->box[k] = from->box[k];
+}  /* Stats_merge */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Gen_world
+ * Purpose:    Use a counter-based random number generator to create
+ *             rows [first_row, last_row) of generation 0
+ * In args:    first_row, last_row
+ *             seed:  gen_seed, or an ensemble world's
+ *             threshold:  a cell is alive if its hash is less
+ * Out arg:    wp:  stores generation 0
+ * In globals: n, row0
+ *
+ * Note:       Each cell only depends on the seed and its position in
+ *             the whole world, so the rows can be generated by any
+ *             thread (or process) in any order.  The rows come from
+ *             Life_seed_row, so Life_seed makes the same world.
+ */
+void Gen_world(word_t wp[], int first_row, int last_row, uint64_t seed,
+      uint64_t threshold) {
+    int i;
+    
+    for (i = first_row; i < last_row; i++)
+        Life_seed_row(Row(wp, i), n, row0 + i, seed, threshold);
+}  /* Gen_world */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Row_bits
+ * Purpose:    Get up to 64 consecutive cells of a row
+ * In args:    row
+ *             col:  the first cell
+ *             len:  the number of cells, with col + len <= n
+ * Ret val:    The cells, the one in col in bit 0
+ */
+static inline word_t Row_bits(const word_t row[], int col, int len) {
+    int w = col/WORD_BITS, b = col%WORD_BITS;
+    word_t bits = row[w] >> b;
+    
+    if (b > 0 && b + len > WORD_BITS)
+        bits |= row[w+1] << (WORD_BITS - b);
+    return len == WORD_BITS ? bits : bits & (((word_t) 1 << len) - 1);
+}  /* Row_bits */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Count_block
+ * Purpose:    Count the live cells in a block of the world
+ * In args:    wp
+ *             i, j:  the block's top left cell
+ *             rows, cols:  its size;  it mustn't wrap around
+ * Ret val:    The number of live cells
+ */
+static long Count_block(word_t wp[], int i, int j, int rows, int cols) {
+    int row, col, len;
+    long count = 0;
+    
+    for (row = i; row < i + rows; row++)
+        for (col = j; col < j + cols; col += len) {
+            len = j + cols - col < WORD_BITS ? j + cols - col : WORD_BITS;
+            count += __builtin_popcountll(Row_bits(Row(wp, row), col, len));
+        }
+    return count;
+}  /* Count_block */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Print_world
+ * Purpose:    Print the current world, or a window of it
+ * In args:    title
+ *             first_row, first_col:  the window's top left cell
+ *             m:  number of rows in the window
+ *             n:  number of cols in the window
+ *             wp:  current gen
+ *
+ * Note:       Each row is formatted into a buffer and written with a
+ *             single fwrite.
+ */
+void Print_world(char title[], word_t wp[], int first_row,
+      int first_col, int m, int n) {
+    int i, j;
+    char *line = malloc(n+1);
+    
+    for (i = first_row; i < first_row + m; i++) {
+        for (j = 0; j < n; j++)
+            line[j] = Get_cell(wp, i, first_col + j) == LIVE ?
+                  LIVE_IO : DEAD_IO;
+        line[n] = '\n';
+        fwrite(line, 1, n+1, stdout);
+    }
+    printf("%s\n\n", title);
+    free(line);
+}  /* Print_world */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Print_counts
+ * Purpose:    Print the window with a character for each view_scale x
+ *             view_scale block of it (see note 18)
+ * In args:    title, wp
+ * In globals: view_row, view_col, view_m, view_n, view_scale
+ */
+void Print_counts(char title[], word_t wp[]) {
+    int k = view_scale, out_n = (view_n + k - 1)/k;
+    int i, j, rows, cols;
+    long count, cells;
+    char *line = malloc(out_n+1);
+    
+    for (i = view_row; i < view_row + view_m; i += k) {
+        rows = view_row + view_m - i < k ? view_row + view_m - i : k;
+        for (j = 0; j < out_n; j++) {
+            cols = view_n - j*k < k ? view_n - j*k : k;
+            count = Count_block(wp, i, view_col + j*k, rows, cols);
+            cells = (long) rows*cols;
+            if (count == 0)
+                line[j] = DEAD_IO;
+            else if (k <= 3)
+                line[j] = '0' + count;
+            else
+                line[j] = '0' + (9*count + cells - 1)/cells;
+        }
+        line[out_n] = '\n';
+        fwrite(line, 1, out_n+1, stdout);
+    }
+    printf("%s\n\n", title);
+    free(line);
+}  /* Print_counts */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Write_packed
+ * Purpose:    Write the window in the packed format:  a Packed_header_t
+ *             and then the words of each row, shifted so the window's
+ *             first col is bit 0 of the first word
+ * In args:    wp, gen, live
+ * In globals: view_row, view_col, view_m, view_n
+ */
+void Write_packed(word_t wp[], int gen, long live) {
+    Packed_header_t hdr;
+    int words = (view_n + WORD_BITS - 1)/WORD_BITS, i, w, len;
+    word_t *line = malloc(words*sizeof(word_t));
+    
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, "GoLP", 4);
+    hdr.m = view_m;
+    hdr.n = view_n;
+    hdr.words = words;
+    hdr.gen = gen;
+    hdr.live = live;
+    fwrite(&hdr, sizeof(hdr), 1, stdout);
+    
+    for (i = view_row; i < view_row + view_m; i++) {
+        for (w = 0; w < words; w++) {
+            len = view_n - w*WORD_BITS < WORD_BITS ?
+                  view_n - w*WORD_BITS : WORD_BITS;
+            line[w] = Row_bits(Row(wp, i), view_col + w*WORD_BITS, len);
+        }
+        fwrite(line, sizeof(word_t), words, stdout);
+    }
+    free(line);
+}  /* Write_packed */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Write_counts
+ * Purpose:    Write the live counts of the window's view_scale x
+ *             view_scale blocks in the packed format (see note 18)
+ * In args:    wp, gen, live
+ * In globals: view_row, view_col, view_m, view_n, view_scale
+ */
+void Write_counts(word_t wp[], int gen, long live) {
+    Packed_header_t hdr;
+    int k = view_scale, out_n = (view_n + k - 1)/k;
+    int i, j, rows, cols;
+    uint32_t *line = malloc(out_n*sizeof(uint32_t));
+    
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, "GoLD", 4);
+    hdr.m = (view_m + k - 1)/k;
+    hdr.n = out_n;
+    hdr.words = k;
+    hdr.gen = gen;
+    hdr.live = live;
+    fwrite(&hdr, sizeof(hdr), 1, stdout);
+    
+    for (i = view_row; i < view_row + view_m; i += k) {
+        rows = view_row + view_m - i < k ? view_row + view_m - i : k;
+        for (j = 0; j < out_n; j++) {
+            cols = view_n - j*k < k ? view_n - j*k : k;
+            line[j] = Count_block(wp, i, view_col + j*k, rows, cols);
+        }
+        fwrite(line, sizeof(uint32_t), out_n, stdout);
+    }
+    free(line);
+}  /* Write_counts */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Write_delta
+ * Purpose:    Write the window in the delta format:  a keyframe with
+ *             all of its words, or the words that changed since the
+ *             last frame (see note 23)
+ * In args:    wp, gen, live
+ * In globals: view_row, view_col, view_m, view_n, delta_every,
+ *             delta_codec, delta_zcap
+ * In/out globals: delta_frames, delta_prev, delta_cur, delta_buf,
+ *             delta_zbuf, delta_zstd
+ *
+ * Note:       The words are the packed format's, and a change is the
+ *             number of unchanged words since the last change (as a
+ *             LEB128 varint) followed by the XOR of the word with the
+ *             old one.  A delta that would be bigger than a keyframe
+ *             is written as a keyframe.
+ */
+void Write_delta(word_t wp[], int gen, long live) {
+    Delta_header_t hdr;
+    int words = (view_n + WORD_BITS - 1)/WORD_BITS, i, w, len;
+    size_t k, total = (size_t) view_m*words, gap = 0, raw = 0;
+    word_t *tmp, d;
+    const unsigned char *payload = delta_buf;
+    long out = -1;
+    
+    for (i = 0; i < view_m; i++)
+        for (w = 0; w < words; w++) {
+            len = view_n - w*WORD_BITS < WORD_BITS ?
+                  view_n - w*WORD_BITS : WORD_BITS;
+            delta_cur[(size_t) i*words + w] = Row_bits(Row(wp, view_row + i),
+                  view_col + w*WORD_BITS, len);
+        }
+    
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, "GoLC", 4);
+    if (delta_frames % delta_every != 0) {
+        for (k = 0; k < total && raw < total*sizeof(word_t); k++) {
+            d = delta_cur[k] ^ delta_prev[k];
+            if (d == 0) {
+                gap++;
+                continue;
+            }
+            for ( ; gap >= 0x80; gap >>= 7)
+                delta_buf[raw++] = (gap & 0x7F) | 0x80;
+            delta_buf[raw++] = gap;
+            gap = 0;
+            memcpy(delta_buf + raw, &d, sizeof(word_t));
+            raw += sizeof(word_t);
+            hdr.count++;
+        }
+    }
+    if (delta_frames % delta_every == 0 || raw >= total*sizeof(word_t)) {
+        memcpy(hdr.magic, "GoLK", 4);
+        hdr.count = total;
+        payload = (const unsigned char *) delta_cur;
+        raw = total*sizeof(word_t);
+    }
+    
+    /* Any frame that doesn't compress is written as it is */
+#   ifdef USE_LZ4
+    if (delta_codec == CODEC_LZ4 && delta_zcap > 0)
+        out = LZ4_compress_default((const char *) payload,
+              (char *) delta_zbuf, raw, delta_zcap);
+#   endif
+#   ifdef USE_ZSTD
+    if (delta_codec == CODEC_ZSTD) {
+        k = ZSTD_compressCCtx(delta_zstd, delta_zbuf, delta_zcap, payload,
+              raw, ZSTD_LEVEL);
+        if (!ZSTD_isError(k)) out = k;
+    }
+#   endif
+    hdr.m = view_m;
+    hdr.n = view_n;
+    hdr.words = words;
+    hdr.gen = gen;
+    hdr.live = live;
+    hdr.raw_bytes = raw;
+    if (out > 0 && (size_t) out < raw) {
+        hdr.codec = delta_codec;
+        hdr.bytes = out;
+        payload = delta_zbuf;
+    } else {
+        hdr.codec = CODEC_NONE;
+        hdr.bytes = raw;
+    }
+    fwrite(&hdr, sizeof(hdr), 1, stdout);
+    fwrite(payload, 1, hdr.bytes, stdout);
+    
+    tmp = delta_prev;
+    delta_prev = delta_cur;
+    delta_cur = tmp;
+    delta_frames++;
+}  /* Write_delta */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Rle_put
+ * Purpose:    Append a run to the RLE output, breaking lines so they
+ *             aren't longer than RLE_LINE
+ * In args:    count:  length of the run
+ *             tag:  'b', 'o', '$' or '!'
+ * In/out arg: col:  number of chars already on the current line
+ */
+static void Rle_put(long count, char tag, int *col) {
+    char item[32];
+    int len;
+    
+    if (count > 1)
+        len = sprintf(item, "%ld%c", count, tag);
+    else
+        len = sprintf(item, "%c", tag);
+    if (*col + len > RLE_LINE) {
+        putchar('\n');
+        *col = 0;
+    }
+    fputs(item, stdout);
+    *col += len;
+}  /* Rle_put */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Write_rle
+ * Purpose:    Write the window as a run length encoded pattern
+ * In args:    wp, gen, live
+ * In globals: view_row, view_col, view_m, view_n, rule_name
+ *
+ * Note:       Dead cells at the end of a row are left out, and so are
+ *             the empty rows at the end of the window.
+ */
+void Write_rle(word_t wp[], int gen, long live) {
+    int i, j, run_start, col = 0, cell;
+    int last_col = view_col + view_n;
+    long end_rows = 0;
+    
+    printf("#C Generation %d, live = %ld\n", gen, live);
+    printf("x = %d, y = %d, rule = %s\n", view_n, view_m, rule_name);
+    for (i = view_row; i < view_row + view_m; i++) {
+        if (i > view_row) end_rows++;
+        j = view_col;
+        while (j < last_col) {
+            run_start = j;
+            cell = Get_cell(wp, i, j);
+            while (j < last_col && Get_cell(wp, i, j) == cell) j++;
+            if (cell == DEAD && j == last_col) break;
+            if (end_rows > 0) {
+                Rle_put(end_rows, '$', &col);
+                end_rows = 0;
+            }
+            Rle_put(j - run_start, cell == LIVE ? 'o' : 'b', &col);
+        }
+    }
+    Rle_put(1, '!', &col);
+    putchar('\n');
+}  /* Write_rle */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Count_live
+ * Purpose:    Count the live cells in a world
+ * In args:    wp
+ * In globals: m, W
+ * Ret val:    The number of live cells (with MPI, in the whole world:
+ *             every process has to call it)
+ */
+long Count_live(word_t wp[]) {
+    int i, w;
+    long live = 0;
+    
+    for (i = 0; i < m; i++)
+        for (w = 0; w < W; w++)
+            live += __builtin_popcountll(Row(wp, i)[w]);
+#   ifdef USE_MPI
+    MPI_Allreduce(MPI_IN_PLACE, &live, 1, MPI_LONG, MPI_SUM, MPI_COMM_WORLD);
+#   endif
+    
+    return live;
+}  /* Count_live */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Play_life
+ * Purpose:      Play Conway's game of life.  (See header doc)
+ * In args:      rank = rank of threads
+ * In globals:   max_gens, curr_gen, m, tile_m, tile_n, break_flag,
+ *               generate, thread_count, depth, block_gens, live_stride,
+ *               pitch, bench_format, bench_warmup, stats_file
+ * Out globals:  *wp, *twp, live_counts[rank*live_stride ...],
+ *               stats_counts[rank*live_stride ...], bench_wait[rank]
+ * Return val:   NULL
+ *
+ * Note:         Each thread first zeroes its own parts of both worlds
+ *               (see note 9).  Each block of generations a thread
+ *               computes the tiles it gets from Get_tile until there
+ *               are none left.  If
+ *               generation 0 is generated, each thread does a band of
+ *               about m/thread_count whole rows of it.  With -K each
+ *               thread allocates its own scratch buffers, big enough
+ *               for the largest band and its halo.
+ */
+void *Play_life(void* rank) {
+    long myrank = (long) rank;
+    int t;
+    int my_sense = 0;
+    long *my_live = &live_counts[myrank*live_stride];
+    Stats_t *my_stats =
+          stats_file != NULL ? &stats_counts[myrank*live_stride] : NULL;
+    double my_wait = 0.0;
+    struct timespec start, finish;
+    word_t *scratch[2] = {NULL, NULL};
+    size_t scratch_rows = (m + tile_m - 1)/tile_m + 2*depth;
+    
+#   ifdef USE_TRACE
+    Trace_thread(myrank);
+#   endif
+    if (depth > 1) {
+        scratch[0] = Alloc_world(scratch_rows);
+        scratch[1] = Alloc_world(scratch_rows);
+    }
+    First_touch(wp, myrank);
+    First_touch(twp, myrank);
+    Barrier(&my_sense, Get_world);
+    if (generate)
+        Gen_world(wp, myrank*m/thread_count, (myrank+1)*m/thread_count,
+              gen_seed, gen_threshold);
+    Barrier(&my_sense, Start_play);
+    
+    while (curr_gen < max_gens && break_flag == 0) {
+        TRACE_BEGIN(compute);
+        memset(my_live, 0, block_gens*sizeof(long));
+        for (t = 0; my_stats != NULL && t < block_gens; t++)
+            Stats_clear(&my_stats[t]);
+        while ((t = Get_tile(myrank)) >= 0)
+            if (depth > 1)
+                Update_block(t, my_live, scratch, my_stats);
+            else
+                my_live[0] += Update_tile(t / tile_n, t % tile_n,
+                      my_stats);
+        TRACE_END(compute, "compute", compute_ns);
+        
+        if (bench_format != BENCH_OFF && curr_gen >= bench_warmup) {
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            Barrier(&my_sense, End_generation);
+            clock_gettime(CLOCK_MONOTONIC, &finish);
+            my_wait += 1.0e9*(finish.tv_sec - start.tv_sec)
+                  + (finish.tv_nsec - start.tv_nsec);
+        } else {
+            Barrier(&my_sense, End_generation);
+        }
+        if (break_flag == 1) {
+            break;
+        }
+    }
+    bench_wait[myrank] = my_wait;
+    
+    Free_world(scratch[0], scratch_rows);
+    Free_world(scratch[1], scratch_rows);
+    return NULL;
+}  /* Play_life */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Play_hashlife
+ * Purpose:      Play the game with HashLife (see note 12)
+ * In globals:   m, max_gens, out_every, block_gens
+ * In/out globals: *wp, curr_gen, live_count
+ *
+ * Note:         Like Play_gpu, this runs on the main thread and uses
+ *               Plan_block to find the next generation to stop at.
+ */
+void Play_hashlife(void) {
+    long done;
+    int what;
+    
+    First_touch(wp, 0);
+    First_touch(twp, 0);
+    Get_world();
+    if (generate)
+        Gen_world(wp, 0, m, gen_seed, gen_threshold);
+    depth = max_gens > 0 ? max_gens : 1;
+    Start_play();
+    Hl_start(wp);
+    
+    while (curr_gen < max_gens) {
+        TRACE_BEGIN(compute);
+        done = Hl_advance(block_gens);
+        TRACE_END(compute, "compute", compute_ns);
+        curr_gen += done;
+        if (done < block_gens) break;
+        live_count = Hl_live();
+        if ((what = Snapshot_due(curr_gen)) != 0) {
+            Hl_to_world(wp);
+            Queue_snapshot(wp, curr_gen, live_count, what);
+        }
+        Plan_block();
+    }
+    
+    Hl_to_world(wp);
+    Hl_stop();
+}  /* Play_hashlife */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_find
+ * Purpose:      Find the node with the given quadrants, making it if
+ *               there isn't one yet (see note 12)
+ * In args:      nw, ne, sw, se:  nodes of the same level
+ * In/out globals: hl_table, hl_buckets, hl_nodes, hl_free
+ * Ret val:      The node
+ */
+Hl_node_t *Hl_find(Hl_node_t *nw, Hl_node_t *ne, Hl_node_t *sw,
+      Hl_node_t *se) {
+    uint64_t h = Life_cell_hash((uintptr_t) nw, (uintptr_t) ne)
+          ^ Life_cell_hash((uintptr_t) sw, (uintptr_t) se + 1);
+    Hl_node_t **bucket, *node;
+    
+    bucket = &hl_table[h & (hl_buckets - 1)];
+    for (node = *bucket; node != NULL; node = node->next)
+        if (node->nw == nw && node->ne == ne && node->sw == sw
+              && node->se == se)
+            return node;
+    
+    if (hl_free == NULL) Hl_grow();
+    node = hl_free;
+    hl_free = node->next;
+    node->nw = nw;
+    node->ne = ne;
+    node->sw = sw;
+    node->se = se;
+    node->result = NULL;
+    node->level = nw->level + 1;
+    node->result_log = -1;
+    node->mark = 0;
+    node->live = nw->live + ne->live + sw->live + se->live;
+    bucket = &hl_table[h & (hl_buckets - 1)];
+    node->next = *bucket;
+    *bucket = node;
+    hl_nodes++;
+    if ((size_t) hl_nodes > hl_buckets) Hl_rehash(2*hl_buckets);
+    
+    return node;
+}  /* Hl_find */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_grow
+ * Purpose:      Add a block of HL_CHUNK nodes to the free list
+ * In/out globals: hl_free, hl_chunks
+ */
+void Hl_grow(void) {
+    Hl_chunk_t *chunk = malloc(sizeof(Hl_chunk_t));
+    int k;
+    
+    if (chunk == NULL) {
+        fprintf(stderr, "Out of memory for HashLife nodes\n");
+        exit(1);
+    }
+    chunk->prev = hl_chunks;
+    hl_chunks = chunk;
+    for (k = 0; k < HL_CHUNK; k++) {
+        chunk->nodes[k].next = hl_free;
+        hl_free = &chunk->nodes[k];
+    }
+}  /* Hl_grow */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_rehash
+ * Purpose:      Change the number of buckets in the node table
+ * In args:      buckets:  a power of 2
+ * In/out globals: hl_table, hl_buckets
+ */
+void Hl_rehash(size_t buckets) {
+    Hl_node_t **table = calloc(buckets, sizeof(Hl_node_t*));
+    Hl_node_t *node, *next;
+    uint64_t h;
+    size_t b;
+    
+    for (b = 0; b < hl_buckets; b++)
+        for (node = hl_table[b]; node != NULL; node = next) {
+            next = node->next;
+            h = Life_cell_hash((uintptr_t) node->nw, (uintptr_t) node->ne)
+                  ^ Life_cell_hash((uintptr_t) node->sw,
+                                   (uintptr_t) node->se + 1);
+            node->next = table[h & (buckets - 1)];
+            table[h & (buckets - 1)] = node;
+        }
+    free(hl_table);
+    hl_table = table;
+    hl_buckets = buckets;
+}  /* Hl_rehash */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_empty
+ * Purpose:      Get the empty node of a level
+ * In args:      level
+ * In/out globals: hl_empty
+ * Ret val:      The node
+ */
+Hl_node_t *Hl_empty(int level) {
+    Hl_node_t *e;
+    
+    if (hl_empty[level] == NULL) {
+        e = Hl_empty(level - 1);
+        hl_empty[level] = Hl_find(e, e, e, e);
+    }
+    return hl_empty[level];
+}  /* Hl_empty */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_center
+ * Purpose:      Get the middle half of a node, without advancing it
+ * In args:      node:  level >= 2
+ * Ret val:      A node of one level lower
+ */
+Hl_node_t *Hl_center(Hl_node_t *node) {
+    return Hl_find(node->nw->se, node->ne->sw, node->sw->ne, node->se->nw);
+}  /* Hl_center */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_base
+ * Purpose:      Advance the middle 2x2 cells of a 4x4 node one
+ *               generation
+ * In args:      node:  level 2
+ * Ret val:      A level 1 node
+ */
+Hl_node_t *Hl_base(Hl_node_t *node) {
+    Hl_node_t *q[4] = {node->nw, node->ne, node->sw, node->se};
+    Hl_node_t *quad, *c;
+    int cell[4][4], next[2][2];
+    int i, j, di, dj, count;
+    
+    /* q[k] is quadrant k;  each of its cells is a level 0 node */
+    for (i = 0; i < 4; i++)
+        for (j = 0; j < 4; j++) {
+            quad = q[(i/2)*2 + j/2];
+            c = i%2 == 0 ? (j%2 == 0 ? quad->nw : quad->ne)
+                  : (j%2 == 0 ? quad->sw : quad->se);
+            cell[i][j] = c->live != 0;
+        }
+    for (i = 1; i <= 2; i++)
+        for (j = 1; j <= 2; j++) {
+            count = 0;
+            for (di = -1; di <= 1; di++)
+                for (dj = -1; dj <= 1; dj++)
+                    count += cell[i+di][j+dj];
+            count -= cell[i][j];
+            next[i-1][j-1] = Rule_alive(count, cell[i][j]);
+        }
+    
+    return Hl_find(&hl_cell[next[0][0]], &hl_cell[next[0][1]],
+          &hl_cell[next[1][0]], &hl_cell[next[1][1]]);
+}  /* Hl_base */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_next
+ * Purpose:      Advance the middle half of a node 2^log gens
+ * In args:      node:  level k >= 2
+ *               log:  0 <= log <= k-2
+ * Ret val:      A node of level k-1:  the middle of node, 2^log gens
+ *               later
+ *
+ * Note:         The node is cut into nine overlapping nodes of level
+ *               k-1.  With log = k-2 each of them is advanced 2^(k-3)
+ *               gens, the results are put together into four nodes of
+ *               level k-1, and each of those is advanced 2^(k-3) gens
+ *               again.  With a smaller log, the first step just takes
+ *               the middles of the nine, and the second advances 2^log
+ *               gens.  The result is memoized in the node, for one log
+ *               at a time.
+ */
+Hl_node_t *Hl_next(Hl_node_t *node, int log) {
+    Hl_node_t *n00, *n01, *n02, *n10, *n11, *n12, *n20, *n21, *n22;
+    Hl_node_t *result;
+    int full = log == node->level - 2;
+    
+    if (node->live == 0)
+        return Hl_empty(node->level - 1);
+    if (node->result != NULL && node->result_log == log)
+        return node->result;
+    if (node->level == 2) {
+        result = Hl_base(node);
+    } else {
+        n00 = node->nw;
+        n01 = Hl_find(node->nw->ne, node->ne->nw, node->nw->se, node->ne->sw);
+        n02 = node->ne;
+        n10 = Hl_find(node->nw->sw, node->nw->se, node->sw->nw, node->sw->ne);
+        n11 = Hl_find(node->nw->se, node->ne->sw, node->sw->ne, node->se->nw);
+        n12 = Hl_find(node->ne->sw, node->ne->se, node->se->nw, node->se->ne);
+        n20 = node->sw;
+        n21 = Hl_find(node->sw->ne, node->se->nw, node->sw->se, node->se->sw);
+        n22 = node->se;
+        if (full) {
+            n00 = Hl_next(n00, log-1);
+            n01 = Hl_next(n01, log-1);
+            n02 = Hl_next(n02, log-1);
+            n10 = Hl_next(n10, log-1);
+            n11 = Hl_next(n11, log-1);
+            n12 = Hl_next(n12, log-1);
+            n20 = Hl_next(n20, log-1);
+            n21 = Hl_next(n21, log-1);
+            n22 = Hl_next(n22, log-1);
+        } else {
+            n00 = Hl_center(n00);
+            n01 = Hl_center(n01);
+            n02 = Hl_center(n02);
+            n10 = Hl_center(n10);
+            n11 = Hl_center(n11);
+            n12 = Hl_center(n12);
+            n20 = Hl_center(n20);
+            n21 = Hl_center(n21);
+            n22 = Hl_center(n22);
+        }
+        result = Hl_find(
+              Hl_next(Hl_find(n00, n01, n10, n11), full ? log-1 : log),
+              Hl_next(Hl_find(n01, n02, n11, n12), full ? log-1 : log),
+              Hl_next(Hl_find(n10, n11, n20, n21), full ? log-1 : log),
+              Hl_next(Hl_find(n11, n12, n21, n22), full ? log-1 : log));
+    }
+    node->result = result;
+    node->result_log = log;
+    
+    return result;
+}  /* Hl_next */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_build
+ * Purpose:      Make the node for a square of a world
+ * In args:      wp:  the world
+ *               level:  the square is 2^level cells on a side
+ *               top, left:  its top left cell;  with hl_plane cells
+ *               outside the world are dead, and otherwise the world is
+ *               repeated (m and n divide the square's size)
+ * Ret val:      The node
+ */
+Hl_node_t *Hl_build(word_t wp[], int level, long top, long left) {
+    long half;
+    
+    if (level == 0) {
+        if (hl_plane)
+            return &hl_cell[top >= 0 && top < m && left >= 0 && left < n
+                  && Get_cell(wp, top, left)];
+        return &hl_cell[Get_cell(wp, top % m, left % n)];
+    }
+    half = 1L << (level - 1);
+    if (hl_plane && (top >= m || left >= n || top + 2*half <= 0 ||
+          left + 2*half <= 0))
+        return Hl_empty(level);
+    return Hl_find(Hl_build(wp, level-1, top, left),
+          Hl_build(wp, level-1, top, left + half),
+          Hl_build(wp, level-1, top + half, left),
+          Hl_build(wp, level-1, top + half, left + half));
+}  /* Hl_build */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_store
+ * Purpose:      Copy the live cells of a node that are in the world
+ *               into it
+ * In args:      node, top, left:  the node and its top left cell
+ * Out arg:      wp:  should be all dead
+ */
+void Hl_store(Hl_node_t *node, word_t wp[], long top, long left) {
+    long half;
+    
+    if (node->live == 0 || top >= m || left >= n)
+        return;
+    if (node->level == 0) {
+        if (top >= 0 && left >= 0)
+            Set_cell(wp, top, left, LIVE);
+        return;
+    }
+    half = 1L << (node->level - 1);
+    if (top + 2*half <= 0 || left + 2*half <= 0)
+        return;
+    Hl_store(node->nw, wp, top, left);
+    Hl_store(node->ne, wp, top, left + half);
+    Hl_store(node->sw, wp, top + half, left);
+    Hl_store(node->se, wp, top + half, left + half);
+}  /* Hl_store */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_start
+ * Purpose:      Make the HashLife world from generation 0
+ * In args:      wp
+ * In globals:   m, n, hl_plane
+ * Out globals:  hl_root, hl_level, hl_table, hl_buckets, hl_cell
+ *
+ * Note:         On the torus hl_root is a square of 2^hl_level cells
+ *               on a side, at least 4, with copies of the world tiled
+ *               across it.  With -U it's a square centered on the
+ *               world's top left corner that holds all of the world.
+ */
+void Hl_start(word_t wp[]) {
+    int size = m > n ? m : n;
+    
+    hl_buckets = 1 << 16;
+    hl_table = calloc(hl_buckets, sizeof(Hl_node_t*));
+    hl_cell[LIVE].live = 1;
+    hl_empty[0] = &hl_cell[DEAD];
+    
+    if (hl_plane) {
+        for (hl_level = 2; (1L << (hl_level - 1)) < size; hl_level++)
+            ;
+        hl_root = Hl_find(
+              Hl_build(wp, hl_level-1, -(1L << (hl_level-1)),
+                    -(1L << (hl_level-1))),
+              Hl_build(wp, hl_level-1, -(1L << (hl_level-1)), 0),
+              Hl_build(wp, hl_level-1, 0, -(1L << (hl_level-1))),
+              Hl_build(wp, hl_level-1, 0, 0));
+    } else {
+        for (hl_level = 2; (1 << hl_level) < size; hl_level++)
+            ;
+        hl_root = Hl_build(wp, hl_level, 0, 0);
+    }
+}  /* Hl_start */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_step
+ * Purpose:      Advance a world 2^log gens
+ * In args:      root:  the world, as for hl_root
+ *               log
+ * In globals:   hl_plane, hl_level
+ * Ret val:      The new world
+ *
+ * Note:         On the torus the tile is first made big enough by
+ *               tiling it with itself;  the result of a 2x2 tiling is
+ *               the world moved half the tile's size down and right,
+ *               so it's tiled again and the middle taken to move it
+ *               back.  With -U the root grows, with empty space around
+ *               it, until the world is in its middle quarter and 2^log
+ *               is at most an eighth of its size:  then nothing can
+ *               reach the edge of the result.
+ */
+Hl_node_t *Hl_step(Hl_node_t *root, int log) {
+    Hl_node_t *t, *e;
+    
+    if (hl_plane) {
+        while (root->level < log + 3 ||
+              Hl_center(Hl_center(root))->live != root->live) {
+            e = Hl_empty(root->level - 1);
+            root = Hl_find(Hl_find(e, e, e, root->nw),
+                  Hl_find(e, e, root->ne, e),
+                  Hl_find(e, root->sw, e, e),
+                  Hl_find(root->se, e, e, e));
+        }
+        return Hl_next(root, log);
+    }
+    
+    for (t = root; t->level < log + 1; )
+        t = Hl_find(t, t, t, t);
+    t = Hl_next(Hl_find(t, t, t, t), log);
+    t = Hl_center(Hl_find(t, t, t, t));
+    while (t->level > hl_level)
+        t = t->nw;
+    return t;
+}  /* Hl_step */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_advance
+ * Purpose:      Advance hl_root gens generations, stopping early if
+ *               every cell dies
+ * In args:      gens
+ * In/out globals: hl_root
+ * Ret val:      The number of generations advanced:  gens, or fewer if
+ *               the world after that many has no live cells, in which
+ *               case hl_root is the last generation with live cells
+ *
+ * Note:         The world takes 2^k gen steps for the bits k of gens,
+ *               from the top.  If a step of 2^k gens kills everything
+ *               it's taken again as two steps of 2^(k-1) gens, from
+ *               the same root, since nodes never change.
+ */
+long Hl_advance(long gens) {
+    long done = 0;
+    int k;
+    
+    for (k = 62; k >= 0; k--)
+        if ((gens >> k) & 1) {
+            if (!Hl_try(k, &done))
+                break;
+        }
+    return done;
+}  /* Hl_advance */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_try
+ * Purpose:      Advance hl_root 2^log gens, or as far as it can go
+ *               without every cell dying
+ * In args:      log
+ * In/out arg:   done:  incremented by the number of gens advanced
+ * In/out globals: hl_root
+ * Ret val:      1 if it went all 2^log gens, 0 otherwise
+ */
+int Hl_try(int log, long *done) {
+    Hl_node_t *next;
+    
+    if (hl_nodes > hl_max_nodes)
+        Hl_collect();
+    next = Hl_step(hl_root, log);
+    if (next->live > 0) {
+        hl_root = next;
+        *done += 1L << log;
+        return 1;
+    }
+    if (log == 0)
+        return 0;
+    return Hl_try(log-1, done) && Hl_try(log-1, done);
+}  /* Hl_try */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_live
+ * Purpose:      Count the live cells in the world
+ * In globals:   hl_root, hl_level, hl_plane, m, n
+ * Ret val:      The count.  On the torus hl_root holds
+ *               4^hl_level/(m*n) copies of the world.
+ */
+long Hl_live(void) {
+    if (hl_plane)
+        return hl_root->live;
+    return hl_root->live / (((1L << hl_level)/m) * ((1L << hl_level)/n));
+}  /* Hl_live */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_to_world
+ * Purpose:      Copy the HashLife world into a packed world
+ * Out arg:      wp
+ * In globals:   hl_root, hl_level, hl_plane, m, W, pitch
+ */
+void Hl_to_world(word_t wp[]) {
+    long half = 1L << (hl_root->level - 1);
+    int i;
+    
+    for (i = 0; i < m; i++)
+        memset(Row(wp, i), 0, W*sizeof(word_t));
+    if (hl_plane)
+        Hl_store(hl_root, wp, -half, -half);
+    else
+        Hl_store(hl_root, wp, 0, 0);
+    Refresh_halo(wp);
+}  /* Hl_to_world */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_collect
+ * Purpose:      Free the nodes that can't be reached from hl_root or
+ *               the empty nodes
+ * In/out globals: hl_table, hl_nodes, hl_free
+ *
+ * Note:         Memoized results are kept if their nodes are.  If that
+ *               leaves more than half of hl_max_nodes, the results are
+ *               all forgotten and it's done again.
+ */
+void Hl_collect(void) {
+    Hl_node_t **link, *node;
+    int pass, level;
+    size_t b;
+    
+    for (pass = 0; pass < 2; pass++) {
+        Hl_mark(hl_root);
+        for (level = 0; level < HL_LEVELS; level++)
+            if (hl_empty[level] != NULL)
+                Hl_mark(hl_empty[level]);
+        for (b = 0; b < hl_buckets; b++)
+            for (link = &hl_table[b]; (node = *link) != NULL; ) {
+                if (node->mark) {
+                    node->mark = 0;
+                    link = &node->next;
+                } else {
+                    *link = node->next;
+                    node->next = hl_free;
+                    hl_free = node;
+                    hl_nodes--;
+                }
+            }
+        if (hl_nodes <= hl_max_nodes/2)
+            break;
+        for (b = 0; b < hl_buckets; b++)
+            for (node = hl_table[b]; node != NULL; node = node->next)
+                node->result = NULL;
+    }
+}  /* Hl_collect */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_mark
+ * Purpose:      Mark a node and everything it refers to
+ * In args:      node
+ */
+void Hl_mark(Hl_node_t *node) {
+    if (node->level == 0 || node->mark)
+        return;
+    node->mark = 1;
+    Hl_mark(node->nw);
+    Hl_mark(node->ne);
+    Hl_mark(node->sw);
+    Hl_mark(node->se);
+    if (node->result != NULL)
+        Hl_mark(node->result);
+}  /* Hl_mark */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Hl_stop
+ * Purpose:      Free all the HashLife nodes
+ * In/out globals: hl_chunks, hl_table, hl_empty
+ */
+void Hl_stop(void) {
+    Hl_chunk_t *chunk;
+    
+    while ((chunk = hl_chunks) != NULL) {
+        hl_chunks = chunk->prev;
+        free(chunk);
+    }
+    free(hl_table);
+    memset(hl_empty, 0, sizeof(hl_empty));
+}  /* Hl_stop */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Play_sparse
+ * Purpose:      Play the game with the sparse engine (see note 13)
+ * In globals:   max_gens, generate, gen_seed, gen_threshold
+ * Out globals:  curr_gen, live_count, sp_cells, sp_count
+ *
+ * Note:         Like Play_hashlife, this runs on the main thread.
+ *               There's no packed world:  wp is NULL, so generation 0
+ *               goes straight into the list, and the snapshots are
+ *               drawn from it.
+ */
+void Play_sparse(void) {
+    Get_world();
+    if (generate)
+        Sp_generate(gen_seed, gen_threshold);
+    else
+        Sp_unique();
+    depth = max_gens > 0 ? max_gens : 1;
+    live_count = sp_count;
+    if (Snapshot_due(curr_gen) & SNAP_PRINT)
+        Queue_snapshot(NULL, curr_gen, live_count, SNAP_PRINT);
+    Plan_block();
+    Run_sparse();
+}  /* Play_sparse */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Try_sparse
+ * Purpose:      With -E auto, switch to the sparse engine if the world
+ *               is sparse enough (see note 13)
+ * In globals:   engine, live_count, m, n, thread_count, max_gens,
+ *               tile_m, tile_n
+ * Out globals:  break_flag, changed
+ *
+ * Note:         This is called by the last thread at a barrier, so the
+ *               other threads wait while the sparse engine runs.  When
+ *               it gives the world back, every tile is marked changed,
+ *               since wp was rewritten behind the tiles' backs.
+ */
+void Try_sparse(void) {
+    if (engine != ENGINE_AUTO || curr_gen >= max_gens || (rule_birth & 1) ||
+          live_count*SPARSE_RATIO*thread_count >= (long) m*n)
+        return;
+    if (Run_sparse())
+        break_flag = 1;
+    else
+        memset(changed, 1, tile_m*tile_n);
+}  /* Try_sparse */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Run_sparse
+ * Purpose:      Play the sparse engine from curr_gen
+ * In globals:   engine, m, n, thread_count, max_gens, out_every,
+ *               block_gens
+ * In/out globals: *wp, curr_gen, live_count, sp_cells, sp_count
+ * Ret val:      1 if the run is over, 0 if (with -E auto) the world got
+ *               dense enough to go back to the dense engine
+ *
+ * Note:         With -E auto the list starts from wp, and wp is only
+ *               brought up to date to be checkpointed and when this
+ *               returns.  Printed generations are drawn from the list.
+ *               With -E sparse wp is NULL and the list is already set.
+ */
+int Run_sparse(void) {
+    long done;
+    int what;
+    
+    if (wp != NULL)
+        Sp_from_world(wp);
+    while (curr_gen < max_gens) {
+        TRACE_BEGIN(compute);
+        done = Sp_play(block_gens);
+        TRACE_END(compute, "compute", compute_ns);
+        curr_gen += done;
+        if (done < block_gens) break;
+        live_count = sp_count;
+        if ((what = Snapshot_due(curr_gen)) & SNAP_CHECKPOINT) {
+            Sp_to_world(wp);
+            Queue_snapshot(wp, curr_gen, live_count, what);
+        } else if (what != 0) {
+            Queue_snapshot(NULL, curr_gen, live_count, what);
+        }
+        Plan_block();
+        if (engine == ENGINE_AUTO &&
+              sp_count*SPARSE_RATIO*thread_count > 2L*m*n) {
+            Sp_to_world(wp);
+            return 0;
+        }
+    }
+    
+    if (wp != NULL)
+        Sp_to_world(wp);
+    return 1;
+}  /* Run_sparse */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Sp_from_world
+ * Purpose:      Make the list of live cells of a world
+ * In args:      wp
+ * In globals:   m, W
+ * Out globals:  sp_cells, sp_count
+ */
+void Sp_from_world(word_t wp[]) {
+    int i, w;
+    word_t bits;
+    
+    Sp_reserve(Count_live(wp));
+    sp_count = 0;
+    for (i = 0; i < m; i++)
+        for (w = 0; w < W; w++)
+            for (bits = Row(wp, i)[w]; bits != 0; bits &= bits - 1)
+                sp_cells[sp_count++] = Sp_key(i,
+                      w*WORD_BITS + __builtin_ctzll(bits));
+}  /* Sp_from_world */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Sp_to_world
+ * Purpose:      Store the list of live cells in a world
+ * In globals:   m, W, sp_cells, sp_count
+ * Out arg:      wp
+ */
+void Sp_to_world(word_t wp[]) {
+    int i;
+    long k;
+    
+    for (i = 0; i < m; i++)
+        memset(Row(wp, i), 0, W*sizeof(word_t));
+    for (k = 0; k < sp_count; k++)
+        Set_cell(wp, sp_cells[k] >> 32, sp_cells[k] & 0xFFFFFFFF, LIVE);
+    Refresh_halo(wp);
+}  /* Sp_to_world */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Sp_to_window
+ * Purpose:      Store the cells of the list that are in the window's
+ *               rows in a snapshot, without touching its other rows
+ * In globals:   view_row, view_m, pitch, sp_cells, sp_count
+ * Out arg:      wp
+ */
+void Sp_to_window(word_t wp[]) {
+    long k;
+    int i;
+    
+    memset(Row(wp, view_row) - 1, 0, (size_t) view_m*pitch*sizeof(word_t));
+    for (k = 0; k < sp_count; k++) {
+        i = sp_cells[k] >> 32;
+        if (i >= view_row && i < view_row + view_m)
+            Set_cell(wp, i, sp_cells[k] & 0xFFFFFFFF, LIVE);
+    }
+}  /* Sp_to_window */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Sp_append
+ * Purpose:      Add a cell to the end of the list, making room for it
+ *               if there isn't any
+ * In args:      key
+ * In/out globals: sp_cells, sp_next, sp_count, sp_alloc
+ */
+void Sp_append(uint64_t key) {
+    if (sp_count == sp_alloc) {
+        sp_alloc = sp_alloc > 0 ? 2*sp_alloc : 1024;
+        sp_cells = realloc(sp_cells, sp_alloc*sizeof(uint64_t));
+        sp_next = realloc(sp_next, sp_alloc*sizeof(uint64_t));
+    }
+    sp_cells[sp_count++] = key;
+}  /* Sp_append */
+
+
+/* qsort's compare for the list's keys */
+static int Sp_compare(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t*) a, y = *(const uint64_t*) b;
+    
+    return x < y ? -1 : x > y;
+}  /* Sp_compare */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Sp_unique
+ * Purpose:      Sort the list by row and col, and drop the cells that
+ *               are in it more than once
+ * In/out globals: sp_cells, sp_count
+ *
+ * Note:         A parser can set a cell twice (a pattern bigger than
+ *               the world wraps around), and Sp_step counts on each
+ *               live cell being in the list once.
+ */
+void Sp_unique(void) {
+    long k, count = 0;
+    
+    qsort(sp_cells, sp_count, sizeof(uint64_t), Sp_compare);
+    for (k = 0; k < sp_count; k++)
+        if (count == 0 || sp_cells[k] != sp_cells[count-1])
+            sp_cells[count++] = sp_cells[k];
+    sp_count = count;
+}  /* Sp_unique */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Sp_generate
+ * Purpose:      Generate generation 0 into the list, with the same
+ *               cells that Gen_world makes
+ * In args:      seed, threshold
+ * In globals:   m, n, W
+ * Out globals:  sp_cells, sp_count
+ */
+void Sp_generate(uint64_t seed, uint64_t threshold) {
+    int i, w;
+    word_t *row = malloc(W*sizeof(word_t)), bits;
+    
+    for (i = 0; i < m; i++) {
+        Life_seed_row(row, n, i, seed, threshold);
+        for (w = 0; w < W; w++)
+            for (bits = row[w]; bits != 0; bits &= bits - 1)
+                Sp_append(Sp_key(i, w*WORD_BITS + __builtin_ctzll(bits)));
+    }
+    free(row);
+}  /* Sp_generate */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Sp_hash
+ * Purpose:      Hash the list the way World_hash hashes a packed world
+ * In globals:   W
+ * In/out globals: sp_cells:  it's sorted
+ * Ret val:      The hash
+ *
+ * Note:         Sorting puts the cells of each word of a row together,
+ *               so the words can be put together one at a time.
+ */
+uint64_t Sp_hash(void) {
+    uint64_t hash = 0, index, last = 0;
+    word_t word = 0;
+    long k;
+    int j;
+    
+    qsort(sp_cells, sp_count, sizeof(uint64_t), Sp_compare);
+    for (k = 0; k < sp_count; k++) {
+        j = sp_cells[k] & 0xFFFFFFFF;
+        index = (sp_cells[k] >> 32)*W + j/WORD_BITS;
+        if (index != last && word != 0) {
+            hash ^= Life_cell_hash(word, last);
+            word = 0;
+        }
+        last = index;
+        word |= (word_t) 1 << (j%WORD_BITS);
+    }
+    if (word != 0)
+        hash ^= Life_cell_hash(word, last);
+    return hash;
+}  /* Sp_hash */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Sp_play
+ * Purpose:      Compute up to gens generations with the sparse engine
+ * In args:      gens
+ * In/out globals: sp_cells, sp_next, sp_count
+ * Ret val:      The number of generations computed.  This is less than
+ *               gens if every cell died:  the list is then left at the
+ *               last generation with live cells, as End_generation
+ *               does.
+ */
+long Sp_play(int gens) {
+    long t, count;
+    uint64_t *tmp;
+    
+    for (t = 0; t < gens; t++) {
+        count = Sp_step();
+        if (count == 0) return t;
+        tmp = sp_cells;
+        sp_cells = sp_next;
+        sp_next = tmp;
+        sp_count = count;
+    }
+    return gens;
+}  /* Sp_play */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Sp_step
+ * Purpose:      Compute the next generation of the list of live cells
+ * In globals:   m, n, sp_cells, sp_count
+ * Out globals:  sp_next, sp_table
+ * Ret val:      The number of live cells in sp_next
+ *
+ * Note:         Each live cell adds one to the count of each of its
+ *               eight neighbors in the hash table, and marks its own
+ *               slot SP_LIVE.  The slots are then the only cells that
+ *               can be live in the next generation.
+ */
+long Sp_step(void) {
+    long k, count = 0;
+    size_t slot;
+    int i, j, up, down, left, right;
+    
+    Sp_reserve(sp_count);
+    memset(sp_table, 0xFF, sp_slots*sizeof(Sp_slot_t));
+    
+    for (k = 0; k < sp_count; k++) {
+        i = sp_cells[k] >> 32;
+        j = sp_cells[k] & 0xFFFFFFFF;
+        up = i == 0 ? m-1 : i-1;
+        down = i == m-1 ? 0 : i+1;
+        left = j == 0 ? n-1 : j-1;
+        right = j == n-1 ? 0 : j+1;
+        Sp_add(Sp_key(up, left), 1);
+        Sp_add(Sp_key(up, j), 1);
+        Sp_add(Sp_key(up, right), 1);
+        Sp_add(Sp_key(i, left), 1);
+        Sp_add(Sp_key(i, j), SP_LIVE);
+        Sp_add(Sp_key(i, right), 1);
+        Sp_add(Sp_key(down, left), 1);
+        Sp_add(Sp_key(down, j), 1);
+        Sp_add(Sp_key(down, right), 1);
+    }
+    TRACE_COUNT(cells, sp_count);
+    
+    for (slot = 0; slot < sp_slots; slot++)
+        if (sp_table[slot].key != SP_EMPTY &&
+              (sp_table[slot].count >= SP_LIVE ?
+               Rule_alive(sp_table[slot].count - SP_LIVE, 1) :
+               Rule_alive(sp_table[slot].count, 0)))
+            sp_next[count++] = sp_table[slot].key;
+    return count;
+}  /* Sp_step */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Sp_add
+ * Purpose:      Add to the count of a cell in the hash table
+ * In args:      key, inc
+ * In/out globals: sp_table
+ * In globals:   sp_slots
+ *
+ * Note:         The table is open addressed with linear probing, and
+ *               Sp_reserve keeps it at most half full.
+ */
+void Sp_add(uint64_t key, int inc) {
+    size_t slot = Life_cell_hash(key, 0) & (sp_slots - 1);
+    
+    while (sp_table[slot].key != key) {
+        if (sp_table[slot].key == SP_EMPTY) {
+            sp_table[slot].key = key;
+            sp_table[slot].count = 0;
+            break;
+        }
+        slot = (slot + 1) & (sp_slots - 1);
+    }
+    sp_table[slot].count += inc;
+}  /* Sp_add */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Sp_reserve
+ * Purpose:      Make the lists and the hash table big enough for the
+ *               generation after one with count live cells, and size
+ *               the part of the table it uses
+ * In args:      count
+ * In/out globals: sp_cells, sp_next, sp_alloc, sp_table, sp_table_alloc
+ * Out globals:  sp_slots
+ *
+ * Note:         The next generation has at most 9*count live cells,
+ *               and the table gets at least twice that many slots.
+ */
+void Sp_reserve(long count) {
+    if (9*count > sp_alloc) {
+        sp_alloc = 2*9*count;
+        sp_cells = realloc(sp_cells, sp_alloc*sizeof(uint64_t));
+        sp_next = realloc(sp_next, sp_alloc*sizeof(uint64_t));
+    }
+    for (sp_slots = 64; sp_slots < 18*(size_t) count; sp_slots *= 2)
+        ;
+    if (sp_slots > sp_table_alloc) {
+        sp_table_alloc = 2*sp_slots;
+        free(sp_table);
+        sp_table = malloc(sp_table_alloc*sizeof(Sp_slot_t));
+    }
+}  /* Sp_reserve */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Sp_stop
+ * Purpose:      Free the sparse engine's lists and table
+ * Out globals:  sp_cells, sp_next, sp_table, sp_alloc, sp_table_alloc
+ */
+void Sp_stop(void) {
+    free(sp_cells);
+    free(sp_next);
+    free(sp_table);
+    sp_cells = sp_next = NULL;
+    sp_table = NULL;
+    sp_alloc = 0;
+    sp_table_alloc = 0;
+}  /* Sp_stop */
+
+
+#ifdef USE_CUDA
+/*---------------------------------------------------------------------
+ * Function:     Play_gpu
+ * Purpose:      Play the game on the GPU (see note 11)
+ * In globals:   m, n, W, pitch, max_gens, out_every, block_gens
+ * In/out globals: *wp, curr_gen, live_count
+ *
+ * Note:         This does what Play_life and the serial parts of the
+ *               barriers do, on the main thread.  Plan_block is used
+ *               with depth = GPU_BATCH to choose how many generations
+ *               go to the device at a time.
+ */
+void Play_gpu(void) {
+    long live[GPU_BATCH];
+    int done, what;
+    
+    First_touch(wp, 0);
+    First_touch(twp, 0);
+    Get_world();
+    if (generate)
+        Gen_world(wp, 0, m, gen_seed, gen_threshold);
+    depth = GPU_BATCH;
+    Start_play();
+    if (Gpu_start(wp, m, n, W, pitch, rule_birth, rule_survive) != 0) {
+        fprintf(stderr, "Can't find a GPU\n");
+        exit(1);
+    }
+    
+    while (curr_gen < max_gens) {
+        TRACE_BEGIN(compute);
+        done = Gpu_play(block_gens, live);
+        TRACE_END(compute, "compute", compute_ns);
+        curr_gen += done;
+        if (done < block_gens) break;
+        live_count = live[done-1];
+        if ((what = Snapshot_due(curr_gen)) != 0) {
+            Gpu_fetch(wp);
+            Queue_snapshot(wp, curr_gen, live_count, what);
+        }
+        Plan_block();
+    }
+    
+    Gpu_fetch(wp);
+    Gpu_stop();
+}  /* Play_gpu */
+#endif
+
+
+/*---------------------------------------------------------------------
+ * Function:     Tile_active
+ * Purpose:      Decide whether a tile has to be recomputed
+ * In args:      ti, tj:  row and col of the tile
+ * In globals:   tile_m, tile_n, changed, track_active
+ * Return val:   1 if the tile or one of its neighbors (on the torus of
+ *               tiles) changed in the last generation, 0 otherwise
+ *
+ * Note:         The test is the library's, which makes it for the rows
+ *               of a Life_t too.
+ */
+int Tile_active(int ti, int tj) {
+    return !track_active || Life_active(changed, tile_m, tile_n, ti, tj);
+}  /* Tile_active */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Update_tile
+ * Purpose:      Compute a tile of the next generation if it's active,
+ *               and record whether it changed
+ * In args:      ti, tj:  row and col of the tile
+ * In/out arg:   stats:  the tile's stats are added to them, or NULL
+ *               without -s
+ * In globals:   m, n, *wp, tile_n, tile_row0, tile_word0,
+ *               rebalance_every
+ * Out globals:  *twp, next_changed[tile], tile_live[tile],
+ *               tile_cost[tile], tile_hash[tile], tile_stats[tile]
+ * Return val:   The number of live cells in the tile in the next
+ *               generation
+ *
+ * Note:         A tile that isn't recomputed had no births or deaths,
+ *               and its live cells are where they were.
+ */
+long Update_tile(int ti, int tj, Stats_t *stats) {
+    int t = ti*tile_n + tj;
+    int i, w;
+    int first_row = tile_row0[ti], last_row = tile_row0[ti+1];
+    int first_word = tile_word0[tj], last_word = tile_word0[tj+1];
+    long live = 0;
+    word_t diff = 0;
+    uint64_t hash = 0;
+    struct timespec start, finish;
+#   if defined(DEBUG) && !defined(USE_MPI)
+    int j, count;
+#   endif
+    
+    if (!Tile_active(ti, tj)) {
+        next_changed[t] = 0;
+        if (stats != NULL) {
+            tile_stats[t].births = tile_stats[t].deaths = 0;
+            Stats_merge(stats, &tile_stats[t]);
+        }
+        TRACE_COUNT(skipped, 1);
+        return tile_live[t];
+    }
+    TRACE_COUNT(tiles, 1);
+    TRACE_COUNT(cells, (long) (last_row - first_row)
+          *(last_word - first_word)*WORD_BITS);
+#   ifdef USE_MPI
+    if (first_row == 0 || last_row == m)
+        Wait_halo();
+#   endif
+    if (rebalance_every > 0)
+        clock_gettime(CLOCK_MONOTONIC, &start);
+    if (stats != NULL)
+        Stats_clear(&tile_stats[t]);
+    
+    for (i = first_row; i < last_row; i++) {
+        live += Update_row(Row(wp, i-1), Row(wp, i), Row(wp, i+1),
+              Row(twp, i), first_word, last_word);
+        Wrap_ghost_rows(twp, i, first_word, last_word);
+        if (stats != NULL)
+            diff |= Row_stats(&tile_stats[t], Row(wp, i), Row(twp, i), i,
+                  first_word, last_word);
+        else
+            for (w = first_word; w < last_word; w++)
+                diff |= Row(twp, i)[w] ^ Row(wp, i)[w];
+        if (cycle_ring > 0)
+            hash ^= Life_row_hash(Row(twp, i), (uint64_t) (row0 + i)*W,
+                  first_word, last_word);
+        
+#       if defined(DEBUG) && !defined(USE_MPI)
+        /* Check the packed kernel against Count_nbhrs, which wraps
+         * around this process's rows */
+        for (j = first_word*WORD_BITS; j < last_word*WORD_BITS && j < n; j++) {
+            count = Count_nbhrs(wp, m, n, i, j);
+            if (Get_cell(twp, i, j) != Rule_alive(count, Get_cell(wp, i, j)))
+                printf("curr_gen = %d, i = %d, j = %d, count = %d: "
+                       "kernel mismatch\n", curr_gen, i, j, count);
+        }
+#       endif
+    }
+    
+    next_changed[t] = diff != 0;
+    tile_live[t] = live;
+    tile_hash[t] = hash;
+    if (stats != NULL)
+        Stats_merge(stats, &tile_stats[t]);
+    if (rebalance_every > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &finish);
+        tile_cost[t] += 1.0e9*(finish.tv_sec - start.tv_sec)
+              + (finish.tv_nsec - start.tv_nsec);
+    }
+    return live;
+}  /* Update_tile */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Update_block
+ * Purpose:      Compute a band of rows block_gens generations ahead
+ *               (see note 8)
+ * In args:      ti:  the band (a tile row)
+ * Out arg:      live:  live[t] is incremented by the number of live
+ *               cells in the band in generation t+1 of the block
+ * In/out arg:   stats:  the band's stats for generation t+1 are added
+ *               to stats[t], or NULL without -s
+ * Scratch:      scratch:  two buffers of at least rows + 2*block_gens
+ *               rows of pitch words
+ * In globals:   m, pitch, *wp, tile_row0, block_gens, rebalance_every,
+ *               tile_m
+ * Out globals:  *twp, tile_cost[ti], tile_hash[ti], band_live
+ *
+ * Note:         Local row l stands for row first_row - block_gens + l
+ *               of the torus, wrapped.  Generation t of the block is
+ *               valid in local rows [t, len-t), so the last generation
+ *               is exactly the band, and is stored straight into twp.
+ *               The first reads wp straight, and the others go back
+ *               and forth between the scratch buffers.
+ */
+void Update_block(int ti, long live[], word_t *scratch[], Stats_t stats[]) {
+    int first_row = tile_row0[ti], rows = tile_row0[ti+1] - first_row;
+    int h = block_gens, len = rows + 2*h;
+    int t, l, i;
+    const word_t *in[3];
+    word_t *out;
+    long count;
+    uint64_t hash = 0;
+    struct timespec start, finish;
+    
+    if (rebalance_every > 0)
+        clock_gettime(CLOCK_MONOTONIC, &start);
+#   ifdef USE_MPI
+    if (first_row - h < 0 || first_row + rows + h > m)
+        Wait_halo();
+#   endif
+    
+    for (t = 1; t <= h; t++) {
+        if (stats != NULL)
+            band_live[(t-1)*tile_m + ti] = 0;
+        for (l = t; l < len - t; l++) {
+            i = first_row - h + l;
+            if (t == 1) {
+                in[0] = Torus_row(wp, i-1);
+                in[1] = Torus_row(wp, i);
+                in[2] = Torus_row(wp, i+1);
+            } else {
+                in[0] = scratch[(t-1) & 1] + (l-1)*pitch + 1;
+                in[1] = in[0] + pitch;
+                in[2] = in[1] + pitch;
+            }
+            if (t == h)
+                out = Row(twp, i);
+            else
+                out = scratch[t & 1] + l*pitch + 1;
+            
+            count = Update_row(in[0], in[1], in[2], out, 0, W);
+            if (l >= h && l < h + rows) {
+                live[t-1] += count;
+                if (stats != NULL) {
+                    band_live[(t-1)*tile_m + ti] += count;
+                    Row_stats(&stats[t-1], in[1], out, i, 0, W);
+                }
+            }
+            if (t == h) {
+                Wrap_ghost_rows(twp, i, 0, W);
+                if (cycle_ring > 0)
+                    hash ^= Life_row_hash(out, (uint64_t) (row0 + i)*W, 0, W);
+            }
+        }
+    }
+    tile_hash[ti] = hash;
+    TRACE_COUNT(tiles, 1);
+    TRACE_COUNT(cells, (long) rows*W*WORD_BITS*h);
+    
+    if (rebalance_every > 0) {
+        clock_gettime(CLOCK_MONOTONIC, &finish);
+        tile_cost[ti] += 1.0e9*(finish.tv_sec - start.tv_sec)
+              + (finish.tv_nsec - start.tv_nsec);
+    }
+}  /* Update_block */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Plan_block
+ * Purpose:      Choose how many generations to compute before the next
+ *               barrier
+ * In globals:   depth, curr_gen, max_gens, out_every, ckpt_every,
+ *               rebalance_every, bench_format, bench_warmup
+ * Out globals:  block_gens, bench_started, bench_gen0, bench_start
+ *
+ * Note:         The block stops at the next generation that's printed,
+ *               checkpointed or rebalanced at, so those happen at a
+ *               barrier just as they do without -K.  It also stops at
+ *               the end of the benchmark's warmup, and since every
+ *               engine calls this at the start of each block, it's
+ *               where the benchmark's clock is started.
+ */
+void Plan_block(void) {
+    block_gens = depth;
+    if (block_gens > max_gens - curr_gen)
+        block_gens = max_gens - curr_gen;
+    if (out_every > 0 && block_gens > out_every - curr_gen % out_every)
+        block_gens = out_every - curr_gen % out_every;
+    if (ckpt_every > 0 && block_gens > ckpt_every - curr_gen % ckpt_every)
+        block_gens = ckpt_every - curr_gen % ckpt_every;
+    if (rebalance_every > 0 &&
+          block_gens > rebalance_every - curr_gen % rebalance_every)
+        block_gens = rebalance_every - curr_gen % rebalance_every;
+    if (curr_gen < bench_warmup && block_gens > bench_warmup - curr_gen)
+        block_gens = bench_warmup - curr_gen;
+    if (bench_format != BENCH_OFF && !bench_started &&
+          curr_gen >= bench_warmup) {
+        bench_started = 1;
+        bench_gen0 = curr_gen;
+        clock_gettime(CLOCK_MONOTONIC, &bench_start);
+    }
+}  /* Plan_block */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Decompose
+ * Purpose:      Cut the world into tiles and set up the threads' work
+ *               queues (see note 3)
+ * In globals:   m, W, tile_rows, thread_count, depth
+ * In/out globals: tile_words
+ * Out globals:  tile_m, tile_n, tile_row0, tile_word0, deques,
+ *               seed_start
+ *
+ * Note:         The sizes of the tile rows differ by at most one, and
+ *               so do the sizes of the tile cols.  To start with each
+ *               thread gets about tile_m*tile_n/thread_count tiles.
+ *               With -K the tiles are whole bands of rows.
+ */
+void Decompose(void) {
+    int k, tiles;
+    
+    if (depth > 1) tile_words = W;
+    tile_row0 = malloc((m + 1)*sizeof(int));
+    tile_word0 = malloc((W + 1)*sizeof(int));
+    tile_m = Split_band(0, m, tile_rows, tile_row0);
+    tile_row0[tile_m] = m;
+    tile_n = Split_band(0, W, tile_words, tile_word0);
+    tile_word0[tile_n] = W;
+    
+    tiles = tile_m*tile_n;
+    deques = aligned_alloc(CACHE_LINE, thread_count*sizeof(Deque_t));
+    seed_start = malloc((thread_count + 1)*sizeof(int));
+    for (k = 0; k <= thread_count; k++)
+        seed_start[k] = (long) k*tiles/thread_count;
+    for (k = 0; k < thread_count; k++)
+        atomic_init(&deques[k].range, Pack_range(0, 0));
+}  /* Decompose */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Split_band
+ * Purpose:      Cut [first, last) into as few pieces of at most
+ *               max_size as possible, with sizes that differ by at
+ *               most one
+ * In args:      first, last, max_size
+ * Out arg:      starts:  the first element of each piece
+ * Return val:   The number of pieces
+ */
+int Split_band(int first, int last, int max_size, int starts[]) {
+    int len = last - first;
+    int pieces = (len + max_size - 1)/max_size;
+    int k;
+    
+    for (k = 0; k < pieces; k++)
+        starts[k] = first + (long) k*len/pieces;
+    return pieces;
+}  /* Split_band */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Seed_deques
+ * Purpose:      Give each thread its starting run of tiles for a new
+ *               generation
+ * In globals:   thread_count, seed_start
+ * Out globals:  deques
+ *
+ * Note:         This is called by the last thread at the barrier, so
+ *               all the queues are full before anyone starts stealing.
+ */
+void Seed_deques(void) {
+    int k;
+    
+    for (k = 0; k < thread_count; k++)
+        atomic_store_explicit(&deques[k].range,
+              Pack_range(seed_start[k], seed_start[k+1]),
+              memory_order_relaxed);
+}  /* Seed_deques */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Get_tile
+ * Purpose:      Get the next tile for a thread to compute
+ * In args:      my_rank
+ * In/out globals: deques
+ * Return val:   The number of the tile, or -1 if every queue is empty
+ *
+ * Note:         The thread takes the head of its own queue.  If its
+ *               queue is empty, it looks at the other queues in turn,
+ *               and steals the back half of the first one that isn't
+ *               empty:  it keeps the first of the stolen tiles, and
+ *               puts the rest in its own queue.  Since nobody steals
+ *               from an empty queue, the plain store is safe.
+ */
+int Get_tile(long my_rank) {
+    Deque_t *mine = &deques[my_rank], *victim;
+    uint64_t range;
+    int head, tail, mid, k;
+    
+    range = atomic_load_explicit(&mine->range, memory_order_relaxed);
+    while (Range_head(range) < Range_tail(range))
+        if (atomic_compare_exchange_weak(&mine->range, &range,
+              Pack_range(Range_head(range) + 1, Range_tail(range))))
+            return Range_head(range);
+    
+    for (k = 1; k < thread_count; k++) {
+        victim = &deques[(my_rank + k) % thread_count];
+        range = atomic_load_explicit(&victim->range, memory_order_relaxed);
+        while ((head = Range_head(range)) < (tail = Range_tail(range))) {
+            mid = tail - (tail - head + 1)/2;
+            if (atomic_compare_exchange_weak(&victim->range, &range,
+                  Pack_range(head, mid))) {
+                atomic_store(&mine->range, Pack_range(mid + 1, tail));
+                return mid;
+            }
+        }
+    }
+    
+    return -1;
+}  /* Get_tile */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Rebalance
+ * Purpose:      Choose the threads' starting runs of tiles so that they
+ *               take about the same time, using the time measured for
+ *               each tile since the last rebalance
+ * In globals:   tile_m, tile_n, thread_count
+ * In/out globals: tile_cost, seed_start
+ *
+ * Note:         This is called by the last thread at the barrier, so
+ *               the new runs are used from the next generation on.
+ */
+void Rebalance(void) {
+    Balance_bands(tile_cost, tile_m*tile_n, thread_count, seed_start);
+    memset(tile_cost, 0, tile_m*tile_n*sizeof(double));
+}  /* Rebalance */
+
+
+/*---------------------------------------------------------------------
+ * Function:     Balance_bands
+ * Purpose:      Cut count items into bands of consecutive items with
+ *               about the same total cost
+ * In args:      cost:  cost of each item
+ *               count:  number of items
+ *               bands:  number of bands
+ * Out arg:      start:  bands+1 entries;  band k is items
+ *               [start[k], start[k+1])
+ *
+ * Note:         Band k ends at the first item at which the running
+ *               total reaches (k+1)/bands of the total.  If nothing
+ *               has been measured, the bands are left alone.
+ */
+void Balance_bands(const double cost[], int count, int bands, int start[]) {
+    double total = 0.0, sum = 0.0;
+    int i, k = 1;
+    
+    for (i = 0; i < count; i++)
+        total += cost[i];
+    if (total <= 0.0) return;
+    
+    start[0] = 0;
+    for (i = 0; i < count && k < bands; i++) {
+        sum += cost[i];
+        while (k < bands && sum >= total*k/bands)
+            start[k++] = i+1;
+    }
+    while (k < bands)
+        start[k++] = count;
+    start[bands] = count;
+}  /* Balance_bands */
+
+/*---------------------------------------------------------------------
+ * Function:   Count_nbhrs
+ * Purpose:    Count the number of living nbhrs of the cell (i,j)
+ * In args:    wp:  current (packed) world
+ *             m:   number of rows in world
+ *             n:   number of cols in world
+ *             i:   row number of current cell
+ *             j:   col number of current cell
+ * Ret val:    The number of neighboring cells with living neighbors
+ *
+ * Note:       This is the cell-at-a-time reference for the packed
+ *             kernels.  It's only used to check them when DEBUG is
+ *             defined.
+ *
+ * Note:       Since the top row of cells is adjacent to the bottom
+ *             row, and since the left col of cells is adjacent to the
+ *             right col, in a very small world, it's possible to
+ *             count a cell as a neighbor twice.  It's counted once for
+ *             each of the eight offsets that reach it.
+ */
+int Count_nbhrs(word_t* wp, int m, int n, int i, int j) {
+    int i1, j1, i2, j2;
+    int count = 0;
+    
+    for (i1 = i-1; i1 <= i+1; i1++)
+        for (j1 = j-1; j1 <= j+1; j1++) {
+            i2 = (i1 + m) % m;
+            j2 = (j1 + n) % n;
+            count += Get_cell(wp, i2, j2);
+        }
+    count -= Get_cell(wp, i, j);
+    
+    return count;
+}  /* Count_nbhrs */
+
+
+/*---------------------------------------------------------------------
+ * Macro:      DEFINE_ROW_STATS
+ * Purpose:    Define a Stats_fn:  add the births, deaths and live
+ *             cells of words [first, last) of a new row to the stats
+ *             (see note 22)
+ * In args:    name:  name of the function
+ *             attr:  function attributes (e.g., the target ISA)
+ *
+ * Note:       This is called on each row as soon as it's computed,
+ *             while the row is still in cache, in place of the loop
+ *             that checks whether a tile changed.  The three popcounts
+ *             a word are most of its cost, so on x86 it's compiled
+ *             again for the popcnt instruction, which every CPU with
+ *             the vector kernels has.
+ */
+#define DEFINE_ROW_STATS(name, attr)                                      \
+attr static word_t name(Stats_t *stats, const word_t old[],               \
+      const word_t row[], int i, int first, int last) {                   \
+    word_t diff = 0, d;                                                   \
+    int w, lo = -1, hi = -1, col;                                         \
+                                                                          \
+    for (w = first; w < last; w++) {                                      \
+        d = old[w] ^ row[w];                                              \
+        diff |= d;                                                        \
+        stats->births += __builtin_popcountll(d & row[w]);                \
+        stats->deaths += __builtin_popcountll(d & old[w]);                \
+        if (row[w] != 0) {                                                \
+            if (lo < 0) lo = w;                                           \
+            hi = w;                                                       \
+        }                                                                 \
+    }                                                                     \
+    if (lo >= 0) {                                                        \
+        if (row0 + i < stats->box[0]) stats->box[0] = row0 + i;           \
+        if (-(row0 + i) < stats->box[2]) stats->box[2] = -(row0 + i);     \
+        col = lo*WORD_BITS + __builtin_ctzll(row[lo]);                    \
+        if (col < stats->box[1]) stats->box[1] = col;                     \
+        col = hi*WORD_BITS + WORD_BITS-1 - __builtin_clzll(row[hi]);      \
+        if (-col < stats->box[3]) stats->box[3] = -col;                   \
+    }                                                                     \
+    return diff;                                                          \
+}
+
+/* The stats kernel for each of the library's kernel ISAs:  on x86
+ * scalar, avx2 and avx512, and elsewhere scalar (and neon)
+ */
+DEFINE_ROW_STATS(Row_stats_scalar, )
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+DEFINE_ROW_STATS(Row_stats_popcnt, __attribute__ ((target ("popcnt"))))
+static Stats_fn *const stats_kernels[] =
+      {Row_stats_scalar, Row_stats_popcnt, Row_stats_popcnt};
+#else
+static Stats_fn *const stats_kernels[] = {Row_stats_scalar, Row_stats_scalar};
+#endif
+
+
+/*---------------------------------------------------------------------
+ * Function:   Select_kernel
+ * Purpose:    Pick the widest kernel the CPU we're running on supports,
+ *             or the one -A chose, specialized to the rule if there's
+ *             one for it
+ * In globals: rule_birth, rule_survive, kernel_isa
+ * Out globals: Life_kernel, kernel_name, Row_stats
+ */
+void Select_kernel(void) {
+    static char name[32];
+    int isa = Life_widest_isa(), generic;
+    
+    if (kernel_isa >= 0 && kernel_isa < isa)
+        isa = kernel_isa;
+    Life_kernel = Life_get_kernel(rule_birth, rule_survive, isa, &generic);
+    Row_stats = stats_kernels[isa];
+    snprintf(name, sizeof(name), "%s%s", Life_isa_name(isa),
+          generic ? "-generic" : "");
+    kernel_name = name;
+}  /* Select_kernel */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Parse_rule
+ * Purpose:    Get the rule from -u (see note 19)
+ * In args:    str:  B<digits>/S<digits>, or the name of one of the
+ *             rules with kernels of their own (see Life_parse_rule)
+ * Out globals: rule_birth, rule_survive, rule_name
+ * Ret val:    1, or 0 if str isn't a rule
+ */
+int Parse_rule(const char str[]) {
+    if (Life_parse_rule(str, &rule_birth, &rule_survive) != LIFE_OK)
+        return 0;
+    Rule_string(rule_birth, rule_survive, rule_name);
+    return 1;
+}  /* Parse_rule */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Rule_string
+ * Purpose:    Write a rule in B/S notation
+ * In args:    birth, survive:  the masks
+ * Out arg:    str:  room for sizeof(rule_name) chars
+ */
+void Rule_string(int birth, int survive, char str[]) {
+    int masks[2], part, k, len = 0;
+    
+    masks[0] = birth;
+    masks[1] = survive;
+    for (part = 0; part < 2; part++) {
+        if (part == 1) str[len++] = '/';
+        str[len++] = "BS"[part];
+        for (k = 0; k <= 8; k++)
+            if (masks[part] & (1 << k))
+                str[len++] = '0' + k;
+    }
+    str[len] = '\0';
+}  /* Rule_string */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Update_row
+ * Purpose:    Compute words [first, last) of a row of the next
+ *             generation, and the ghost cells of the new row that
+ *             copy them
+ * In args:    above, row, below:  rows i-1, i, i+1 of the current gen
+ *             first, last:  range of words to update
+ * Out arg:    out:  row i of the next generation
+ * In globals: n, W, Life_kernel
+ * Ret val:    Number of live cells in the new words
+ *
+ * Note:       Whoever computes word 0 of a row sets the east ghost word
+ *             (column 0), and whoever computes word W-1 sets the west
+ *             ghost word (column n-1).
+ */
+long Update_row(const word_t above[], const word_t row[],
+      const word_t below[], word_t out[], int first, int last) {
+    long live = Life_kernel(above, row, below, out, first, last, n,
+          rule_birth, rule_survive);
+    
+    if (last == W)
+        out[-1] = ((out[W-1] >> ((n-1) % WORD_BITS)) & 1) << (WORD_BITS-1);
+    if (first == 0)
+        out[W] = out[0] & 1;
+    
+    return live;
+}  /* Update_row */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Copy_to_ghost_row
+ * Purpose:    Copy words [first, last) of row 0 (or m-1) of a world,
+ *             along with the ghost words that copy them, into ghost
+ *             row m (or -1)
+ * In args:    row, first, last
+ * Out arg:    ghost
+ * In globals: W
+ */
+void Copy_to_ghost_row(word_t ghost[], const word_t row[], int first,
+      int last) {
+    memcpy(ghost + first, row + first, (last - first)*sizeof(word_t));
+    if (first == 0) ghost[W] = row[W];
+    if (last == W) ghost[-1] = row[-1];
+}  /* Copy_to_ghost_row */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Refresh_halo
+ * Purpose:    Fill in all the ghost cells of a world from its real
+ *             cells.  This is used on generation 0;  after that
+ *             Update_row and Copy_to_ghost_row keep the halo up to date.
+ *             With MPI the ghost rows are fetched from the neighboring
+ *             processes.
+ * In/out arg: wp
+ * In globals: m, n, W
+ */
+void Refresh_halo(word_t wp[]) {
+    int i;
+    word_t *row;
+    
+    for (i = 0; i < m; i++) {
+        row = Row(wp, i);
+        if (n % WORD_BITS != 0)
+            row[W-1] &= ((word_t) 1 << (n % WORD_BITS)) - 1;
+        row[-1] = (word_t) Get_cell(wp, i, n-1) << (WORD_BITS-1);
+        row[W] = row[0] & 1;
+    }
+#   ifdef USE_MPI
+    Start_halo(wp);
+    Wait_halo();
+#   else
+    Copy_to_ghost_row(Row(wp, m), Row(wp, 0), 0, W);
+    Copy_to_ghost_row(Row(wp, -1), Row(wp, m-1), 0, W);
+#   endif
+}  /* Refresh_halo */
+
+/*---------------------------------------------------------------------
+ * Function:   Start_play
+ * Purpose:    Finish generation 0 once all the threads have stored
+ *             their parts of it:  set up the halo, print it, and fill
+ *             the work queues for generation 1
+ * In globals: out_every
+ * In/out globals: *wp
+ * Out globals: live_count
+ *
+ * Note:       With -E auto a sparse world starts out on the sparse
+ *             engine.  With -C generation 0 goes in the ring, and with
+ *             -s its stats are written.
+ */
+void Start_play(void) {
+    Refresh_halo(wp);
+    live_count = Count_live(wp);
+#  ifdef DEBUG
+    printf("Generation 0 live count = %ld, actual prob = %f\n",
+           live_count, ((double) live_count)/((double) world_m*n));
+#  endif
+    if (Snapshot_due(curr_gen) & SNAP_PRINT)
+        Queue_snapshot(wp, curr_gen, live_count, SNAP_PRINT);
+    if (stats_file != NULL)
+        Start_stats();
+    if (cycle_ring > 0)
+        Check_cycle(World_hash(wp));
+    Plan_block();
+    Try_sparse();
+    Seed_deques();
+}  /* Start_play */
+
+
+/*---------------------------------------------------------------------
+ * Function:   End_generation
+ * Purpose:    Finish a block of generations once all the threads have
+ *             computed their parts of it:  add up the live counts, and
+ *             either set break_flag or start the next block
+ * In globals: thread_count, live_counts, live_stride, rebalance_every,
+ *             stats_counts, tile_live, band_live
+ * In/out globals: block_gens
+ * Out globals: break_flag, live_count, block_live, block_stats
+ *
+ * Note:       If every cell died part way through a block, the block
+ *             is done again, stopping at the last generation that had
+ *             live cells:  wp is still the start of the block, and the
+ *             run has to stop with wp holding that generation.  With
+ *             MPI the counts are added up over all the processes, so
+ *             they all make the same choice, and the new boundary rows
+ *             are sent off before the threads are let go.  With -E
+ *             auto the world may spend a while on the sparse engine
+ *             here (see Try_sparse), and with -C curr_gen may jump
+ *             ahead (see Check_cycle).  With -s the stats of each
+ *             generation of the block are written before that.
+ */
+void End_generation(void) {
+    int rank, t;
+    uint64_t hash = 0;
+    
+#   ifdef USE_MPI
+    Wait_halo();
+#   endif
+    for (t = 0; t < block_gens; t++) {
+        block_live[t] = 0;
+        for (rank = 0; rank < thread_count; rank++)
+            block_live[t] += live_counts[rank*live_stride + t];
+        if (stats_file != NULL) {
+            Stats_clear(&block_stats[t]);
+            for (rank = 0; rank < thread_count; rank++)
+                Stats_merge(&block_stats[t],
+                      &stats_counts[rank*live_stride + t]);
+        }
+    }
+#   ifdef USE_MPI
+    MPI_Allreduce(MPI_IN_PLACE, block_live, block_gens, MPI_LONG, MPI_SUM,
+          MPI_COMM_WORLD);
+#   endif
+    for (t = 0; t < block_gens && (block_live[t] > 0 || (rule_birth & 1));
+          t++)
+        live_count = block_live[t];
+    if (t == 0) {
+        live_count = 0;
+        break_flag = 1;
+    } else if (t < block_gens) {
+        block_gens = t;
+        Seed_deques();
+    } else {
+        Pointer_swap();
+        for (t = 0; stats_file != NULL && t < block_gens; t++)
+            Write_stats(curr_gen - block_gens + t + 1, &block_stats[t],
+                  block_live[t],
+                  depth > 1 ? band_live + t*tile_m : tile_live);
+        if (cycle_ring > 0) {
+            for (t = 0; t < tile_m*tile_n; t++)
+                hash ^= tile_hash[t];
+#           ifdef USE_MPI
+            MPI_Allreduce(MPI_IN_PLACE, &hash, 1, MPI_UINT64_T, MPI_BXOR,
+                  MPI_COMM_WORLD);
+#           endif
+            Check_cycle(hash);
+        }
+        if (rebalance_every > 0 && curr_gen % rebalance_every == 0)
+            Rebalance();
+        Plan_block();
+        Try_sparse();
+        Seed_deques();
+#       ifdef USE_MPI
+        Start_halo(wp);
+#       endif
+    }
+}  /* End_generation */
+
+
+/*---------------------------------------------------------------------
+ * Function:   World_hash
+ * Purpose:    Hash a whole world the way the tiles hash their parts
+ *             of it (see note 14)
+ * In args:    wp
+ * In globals: m, W
+ * Ret val:    The hash, combined over the processes with MPI
+ */
+uint64_t World_hash(word_t wp[]) {
+    uint64_t hash = 0;
+    int i;
+    
+    for (i = 0; i < m; i++)
+        hash ^= Life_row_hash(Row(wp, i), (uint64_t) (row0 + i)*W, 0, W);
+#   ifdef USE_MPI
+    MPI_Allreduce(MPI_IN_PLACE, &hash, 1, MPI_UINT64_T, MPI_BXOR,
+          MPI_COMM_WORLD);
+#   endif
+    return hash;
+}  /* World_hash */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Check_cycle
+ * Purpose:    Look for the current generation in the ring of recent
+ *             hashes, and skip whole periods once a cycle is known
+ *             (see note 14)
+ * In args:    hash:  the current generation's hash
+ * In globals: cycle_ring, max_gens, out_every, live_count, mpi_rank
+ * In/out globals: ring_hash, ring_gen, ring_next, cycle_period,
+ *             curr_gen
+ *
+ * Note:       After a jump, wp is the same world as before, so the
+ *             new generation is printed here if it should be.
+ */
+void Check_cycle(uint64_t hash) {
+    int k, target, jump;
+    
+    if (cycle_period == 0) {
+        for (k = 0; k < cycle_ring; k++)
+            if (ring_gen[k] >= 0 && ring_hash[k] == hash) {
+                cycle_period = curr_gen - ring_gen[k];
+                if (mpi_rank == 0)
+                    fprintf(stderr, "Generation %d repeats generation %d:  "
+                          "period %d\n", curr_gen, ring_gen[k],
+                          cycle_period);
+                break;
+            }
+        ring_hash[ring_next] = hash;
+        ring_gen[ring_next] = curr_gen;
+        ring_next = (ring_next + 1) % cycle_ring;
+        if (cycle_period == 0) return;
+    }
+    
+    target = max_gens;
+    if (out_every > 0 && target > (curr_gen/out_every + 1)*out_every)
+        target = (curr_gen/out_every + 1)*out_every;
+    if (ckpt_every > 0 && target > (curr_gen/ckpt_every + 1)*ckpt_every)
+        target = (curr_gen/ckpt_every + 1)*ckpt_every;
+    jump = (target - curr_gen)/cycle_period*cycle_period;
+    if (jump == 0) return;
+    curr_gen += jump;
+    if (Snapshot_due(curr_gen) != 0)
+        Queue_snapshot(wp, curr_gen, live_count, Snapshot_due(curr_gen));
+}  /* Check_cycle */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Start_stats
+ * Purpose:    Write the stats of generation 0, or of the checkpoint's
+ *             generation with -r (see note 22)
+ * In globals: *wp, m, W, n, tile_m, tile_n, tile_row0, tile_word0,
+ *             curr_gen, live_count
+ * Out globals: tile_live
+ *
+ * Note:       Generation 0 doesn't come from the kernels, so this is
+ *             the one pass over a world that -s makes.  tile_live is
+ *             overwritten by generation 1, which computes every tile.
+ */
+void Start_stats(void) {
+    Stats_t stats;
+    int i, ti, tj, col, cols;
+    
+    Stats_clear(&stats);
+    for (i = 0; i < m; i++)
+        Row_stats(&stats, Row(wp, i), Row(wp, i), i, 0, W);
+    for (ti = 0; ti < tile_m; ti++)
+        for (tj = 0; tj < tile_n; tj++) {
+            col = tile_word0[tj]*WORD_BITS;
+            cols = tile_word0[tj+1]*WORD_BITS < n ?
+                  tile_word0[tj+1]*WORD_BITS - col : n - col;
+            tile_live[ti*tile_n + tj] = Count_block(wp, tile_row0[ti], col,
+                  tile_row0[ti+1] - tile_row0[ti], cols);
+        }
+    Write_stats(curr_gen, &stats, live_count, tile_live);
+}  /* Start_stats */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Write_stats
+ * Purpose:    Write a generation's line of the -s file (see note 22)
+ * In args:    gen
+ *             stats:  this process's stats for the generation
+ *             live:  the whole world's live count
+ *             counts:  live cells in each of this process's tiles
+ * In globals: tile_m, tile_n, tile_row0, tile_word0, n, stats_out,
+ *             mpi_rank, bench_started, bench_gen0
+ * In/out globals: stats_births, stats_deaths
+ *
+ * Note:       A tile with live cells goes in bin ceil(10*density), so
+ *             bin k has the tiles with densities in ((k-1)/10, k/10],
+ *             and bin 0 the empty ones.  With MPI the stats are
+ *             added up over the processes, and process 0 writes them.
+ */
+void Write_stats(int gen, const Stats_t *stats, long live,
+      const long counts[]) {
+    long sums[STATS_BINS + 3] = {0};   /* births, deaths, bins */
+    int box[4], ti, tj, k;
+    long cells, cols;
+    
+    sums[0] = stats->births;
+    sums[1] = stats->deaths;
+    memcpy(box, stats->box, sizeof(box));
+    for (ti = 0; ti < tile_m; ti++)
+        for (tj = 0; tj < tile_n; tj++) {
+            cols = (tile_word0[tj+1]*WORD_BITS < n ?
+                  tile_word0[tj+1]*WORD_BITS : n) - tile_word0[tj]*WORD_BITS;
+            cells = (tile_row0[ti+1] - tile_row0[ti])*cols;
+            k = (counts[ti*tile_n + tj]*STATS_BINS + cells - 1)/cells;
+            sums[2 + k]++;
+        }
+#   ifdef USE_MPI
+    MPI_Allreduce(MPI_IN_PLACE, sums, STATS_BINS + 3, MPI_LONG, MPI_SUM,
+          MPI_COMM_WORLD);
+    MPI_Allreduce(MPI_IN_PLACE, box, 4, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+#   endif
+    if (bench_started && gen > bench_gen0) {
+        stats_births += sums[0];
+        stats_deaths += sums[1];
+    }
+    if (mpi_rank != 0) return;
+    
+    if (box[0] == INT_MAX)
+        fprintf(stats_out, "%d,%ld,%ld,%ld,-1,-1,-1,-1", gen, live,
+              sums[0], sums[1]);
+    else
+        fprintf(stats_out, "%d,%ld,%ld,%ld,%d,%d,%d,%d", gen, live,
+              sums[0], sums[1], box[0], box[1], -box[2], -box[3]);
+    for (k = 0; k <= STATS_BINS; k++)
+        fprintf(stats_out, ",%ld", sums[2 + k]);
+    fprintf(stats_out, "\n");
+}  /* Write_stats */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Barrier
+ * Purpose:    Block until all threads have called the barrier.  The
+ *             last thread to arrive runs serial before releasing the
+ *             others.
+ * In/out arg: my_sense:  the caller's copy of the barrier sense.  It
+ *             should be 0 the first time a thread calls Barrier.
+ * In arg:     serial:  work to do while the other threads wait
+ * In globals: thread_count, barrier_spins
+ * In/out globals: barrier_count, barrier_sense, parked_count
+ *
+ * Note:       A waiting thread spins until the shared sense matches
+ *             its own, and after barrier_spins tries sleeps on
+ *             ok_to_proceed.  The last thread only takes barrier_mutex
+ *             to wake threads if some of them are asleep.
+ */
+void Barrier(int *my_sense, Serial_t serial) {
+    int sense = !*my_sense;
+    int spins;
+    
+    *my_sense = sense;
+    if (atomic_fetch_add(&barrier_count, 1) == thread_count - 1) {
+        TRACE_BEGIN(work);
+        serial();
+        TRACE_END(work, "serial", serial_ns);
+        atomic_store(&barrier_count, 0);
+        atomic_store(&barrier_sense, sense);
+        if (atomic_load(&parked_count) > 0) {
+            pthread_mutex_lock(&barrier_mutex);
+            pthread_cond_broadcast(&ok_to_proceed);
+            pthread_mutex_unlock(&barrier_mutex);
+        }
+    } else {
+        TRACE_BEGIN(spin);
+        for (spins = 0; spins < barrier_spins; spins++) {
+            if (atomic_load_explicit(&barrier_sense, memory_order_acquire)
+                  == sense) {
+                TRACE_END(spin, "spin", spin_ns);
+                return;
+            }
+            Cpu_relax();
+        }
+        TRACE_END(spin, "spin", spin_ns);
+        TRACE_BEGIN(park);
+        pthread_mutex_lock(&barrier_mutex);
+        atomic_fetch_add(&parked_count, 1);
+        while (atomic_load(&barrier_sense) != sense)
+            pthread_cond_wait(&ok_to_proceed, &barrier_mutex);
+        atomic_fetch_sub(&parked_count, 1);
+        pthread_mutex_unlock(&barrier_mutex);
+        TRACE_COUNT(parks, 1);
+        TRACE_END(park, "park", park_ns);
+    }
+}  /* Barrier */
+
+/*---------------------------------------------------------------------
+ * Function:   Pointer_swap
+ * Purpose:    Swaps pointers for generations and for the tiles'
+ *             changed flags, and hands the new generation to the
+ *             writer if it should be printed or checkpointed
+ * In globals: block_gens, m, n, live_count, out_every, ckpt_every
+ * In/out:     *wp, *twp, changed, next_changed, curr_gen
+ *
+ */
+void Pointer_swap(void) {
+    word_t *tmp;
+    unsigned char *tmp_changed;
+    
+    tmp = wp;
+    wp = twp;
+    twp = tmp;
+    tmp_changed = changed;
+    changed = next_changed;
+    next_changed = tmp_changed;
+    curr_gen += block_gens;
+    if (Snapshot_due(curr_gen) != 0)
+        Queue_snapshot(wp, curr_gen, live_count, Snapshot_due(curr_gen));
+}  /* Pointer_swap */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Start_writer
+ * Purpose:    Allocate the snapshot buffers and start the writer thread
+ * In globals: world_m, halo, pitch, out_format, delta_codec, view_m,
+ *             view_n
+ * Out globals: snapshots, writer_handle, snap_mutex, snap_ready,
+ *             snap_free, delta_prev, delta_cur, delta_buf, delta_zbuf,
+ *             delta_zcap, delta_zstd
+ */
+void Start_writer(void) {
+    int i;
+    size_t words = (size_t) view_m*Word_count(view_n);
+    
+    for (i = 0; i < SNAPSHOTS; i++)
+        snapshots[i].world = Alloc_world(world_m + 2*halo);
+    if (out_format == FMT_DELTA) {
+        /* A changed word takes up to 10 bytes for its gap and 8 for
+         * its bits */
+        delta_prev = malloc(words*sizeof(word_t));
+        delta_cur = malloc(words*sizeof(word_t));
+        delta_buf = malloc(words*18);
+        delta_zcap = 0;
+#       ifdef USE_LZ4
+        if (delta_codec == CODEC_LZ4 && words*18 <= LZ4_MAX_INPUT_SIZE)
+            delta_zcap = LZ4_compressBound(words*18);
+#       endif
+#       ifdef USE_ZSTD
+        if (delta_codec == CODEC_ZSTD) {
+            delta_zcap = ZSTD_compressBound(words*18);
+            delta_zstd = ZSTD_createCCtx();
+        }
+#       endif
+        delta_zbuf = delta_zcap > 0 ? malloc(delta_zcap) : NULL;
+    }
+    pthread_mutex_init(&snap_mutex, NULL);
+    pthread_cond_init(&snap_ready, NULL);
+    pthread_cond_init(&snap_free, NULL);
+    pthread_create(&writer_handle, NULL, Write_snapshots, NULL);
+}  /* Start_writer */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Stop_writer
+ * Purpose:    Wait for the writer to print the snapshots that are
+ *             still queued, and then free everything Start_writer
+ *             allocated
+ * In/out globals: writer_done, snapshots, delta_prev, delta_cur,
+ *             delta_buf, delta_zbuf, delta_zstd
+ */
+void Stop_writer(void) {
+    int i;
+    
+    pthread_mutex_lock(&snap_mutex);
+    writer_done = 1;
+    pthread_cond_signal(&snap_ready);
+    pthread_mutex_unlock(&snap_mutex);
+    pthread_join(writer_handle, NULL);
+    
+    for (i = 0; i < SNAPSHOTS; i++)
+        Free_world(snapshots[i].world, world_m + 2*halo);
+    if (out_format == FMT_DELTA) {
+        free(delta_prev);
+        free(delta_cur);
+        free(delta_buf);
+        free(delta_zbuf);
+#       ifdef USE_ZSTD
+        if (delta_codec == CODEC_ZSTD) ZSTD_freeCCtx(delta_zstd);
+#       endif
+    }
+    pthread_mutex_destroy(&snap_mutex);
+    pthread_cond_destroy(&snap_ready);
+    pthread_cond_destroy(&snap_free);
+}  /* Stop_writer */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Queue_snapshot
+ * Purpose:    Copy a world into a free snapshot buffer and queue it
+ *             for the writer.  If no buffer is free, wait for the
+ *             writer to finish one.
+ * In args:    wp:  the world, or NULL to draw the sparse engine's
+ *                list (see Sp_to_window)
+ *             gen:  its generation number
+ *             live:  the number of live cells in it
+ *             what:  SNAP_PRINT and/or SNAP_CHECKPOINT
+ * In globals: m, halo, pitch, mpi_rank, view_row, view_m
+ * In/out globals: snapshots, snap_first, snap_queued
+ *
+ * Note:       With MPI every process has to call it, and the world is
+ *             gathered into the snapshot on process 0.  Unless it's
+ *             checkpointed, only the window's rows are (see note 18).
+ */
+void Queue_snapshot(word_t wp[], int gen, long live, int what) {
+    Snapshot_t *snap;
+    TRACE_BEGIN(copy);
+    
+#   ifdef USE_MPI
+    if (mpi_rank != 0) {
+        Gather_world(wp, NULL, !(what & SNAP_CHECKPOINT));
+        return;
+    }
+#   endif
+    pthread_mutex_lock(&snap_mutex);
+    while (snap_queued == SNAPSHOTS)
+        pthread_cond_wait(&snap_free, &snap_mutex);
+    snap = &snapshots[(snap_first + snap_queued) % SNAPSHOTS];
+    pthread_mutex_unlock(&snap_mutex);
+    
+    /* Only this thread touches a slot that isn't queued */
+#   ifdef USE_MPI
+    Gather_world(wp, snap->world, !(what & SNAP_CHECKPOINT));
+#   else
+    if (wp == NULL)
+        Sp_to_window(snap->world);
+    else if (what & SNAP_CHECKPOINT)
+        memcpy(snap->world, wp, (size_t) (m + 2*halo)*pitch*sizeof(word_t));
+    else
+        memcpy(Row(snap->world, view_row) - 1, Row(wp, view_row) - 1,
+              (size_t) view_m*pitch*sizeof(word_t));
+#   endif
+    snap->gen = gen;
+    snap->live = live;
+    snap->what = what;
+    
+    pthread_mutex_lock(&snap_mutex);
+    snap_queued++;
+    pthread_cond_signal(&snap_ready);
+    pthread_mutex_unlock(&snap_mutex);
+    TRACE_END(copy, "snapshot", io_ns);
+}  /* Queue_snapshot */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Write_snapshots
+ * Purpose:    Thread function for the writer:  print or checkpoint
+ *             queued snapshots in order until Stop_writer is called
+ *             and the queue is empty
+ * In globals: view_row, view_col, view_m, view_n, view_scale,
+ *             out_format, out_header
+ * In/out globals: snapshots, snap_first, snap_queued, writer_done
+ * Return val: NULL
+ */
+void *Write_snapshots(void* ignore) {
+    Snapshot_t *snap;
+    char title[MAX_TITLE];
+    
+    (void) ignore;
+#   ifdef USE_TRACE
+    Trace_thread(thread_count);
+#   endif
+    while (1) {
+        pthread_mutex_lock(&snap_mutex);
+        while (snap_queued == 0 && !writer_done)
+            pthread_cond_wait(&snap_ready, &snap_mutex);
+        if (snap_queued == 0) {
+            pthread_mutex_unlock(&snap_mutex);
+            break;
+        }
+        snap = &snapshots[snap_first];
+        pthread_mutex_unlock(&snap_mutex);
+        
+        TRACE_BEGIN(printing);
+        if (!(snap->what & SNAP_PRINT)) {
+            /* Only a checkpoint */
+        } else if (out_format == FMT_PACKED && view_scale > 1) {
+            Write_counts(snap->world, snap->gen, snap->live);
+        } else if (out_format == FMT_PACKED) {
+            Write_packed(snap->world, snap->gen, snap->live);
+        } else if (out_format == FMT_RLE) {
+            Write_rle(snap->world, snap->gen, snap->live);
+        } else if (out_format == FMT_DELTA) {
+            Write_delta(snap->world, snap->gen, snap->live);
+        } else {
+            if (out_header)
+                printf("# gen %d live %ld\n", snap->gen, snap->live);
+            sprintf(title, "Generation %d", snap->gen);
+            if (view_scale > 1)
+                Print_counts(title, snap->world);
+            else
+                Print_world(title, snap->world, view_row, view_col,
+                      view_m, view_n);
+        }
+        if (snap->what & SNAP_CHECKPOINT)
+            Write_checkpoint(snap);
+        TRACE_END(printing, "write", io_ns);
+        
+        pthread_mutex_lock(&snap_mutex);
+        snap_first = (snap_first + 1) % SNAPSHOTS;
+        snap_queued--;
+        pthread_cond_signal(&snap_free);
+        pthread_mutex_unlock(&snap_mutex);
+    }
+    fflush(stdout);
+    
+    return NULL;
+}  /* Write_snapshots */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Open_checkpoint
+ * Purpose:    Check a checkpoint against this run, and map its world
+ *             as the starting world if that's possible (see note 17)
+ * In args:    file
+ * In globals: world_m, n, pitch, halo, mpi_size, rule_birth,
+ *             rule_survive, rule_name
+ * Out globals: curr_gen, mapped_world
+ * Ret val:    The mapped world, to be used in place of one from
+ *             Alloc_world(m + 2*halo), or NULL if Read_checkpoint has
+ *             to copy the world in
+ */
+word_t *Open_checkpoint(char file[]) {
+    Ckpt_header_t header;
+    struct stat st;
+    void *base;
+    char rule[sizeof(rule_name)];
+    int fd = open(file, O_RDONLY);
+    
+    if (fd < 0 || read(fd, &header, sizeof(header)) != sizeof(header)
+          || memcmp(header.magic, CKPT_MAGIC, sizeof(header.magic)) != 0
+          || fstat(fd, &st) != 0 || st.st_size < (off_t) (CKPT_HEADER +
+                ((size_t) (header.m + 2*header.halo)*header.pitch
+                 + WORLD_LEAD)*sizeof(word_t))) {
+        fprintf(stderr, "%s isn't a checkpoint\n", file);
+        exit(1);
+    }
+    if (header.m != world_m || header.n != n) {
+        fprintf(stderr, "%s is a %d x %d world, not %d x %d\n", file,
+              header.m, header.n, world_m, n);
+        exit(1);
+    }
+    if (header.birth != rule_birth || header.survive != rule_survive) {
+        Rule_string(header.birth, header.survive, rule);
+        fprintf(stderr, "%s was played with %s, not %s (see -u)\n", file,
+              rule, rule_name);
+        exit(1);
+    }
+    curr_gen = header.gen;
+    
+    if (mpi_size == 1 && header.pitch == pitch && header.halo == halo) {
+        base = mmap(NULL, World_bytes(m + 2*halo), PROT_READ | PROT_WRITE,
+              MAP_PRIVATE, fd, CKPT_HEADER);
+        if (base != MAP_FAILED)
+            mapped_world = (word_t*) base + WORLD_LEAD;
+    }
+    close(fd);
+    return mapped_world;
+}  /* Open_checkpoint */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Read_checkpoint
+ * Purpose:    Copy the world in a checkpoint into a world whose layout
+ *             is different
+ * In args:    file:  checked by Open_checkpoint
+ * Out arg:    wp:  a world of world_m rows
+ * In globals: world_m, W
+ */
+void Read_checkpoint(char file[], word_t wp[]) {
+    Ckpt_header_t header;
+    size_t bytes;
+    word_t *base, *rows;
+    int fd = open(file, O_RDONLY), i;
+    
+    if (fd < 0 || read(fd, &header, sizeof(header)) != sizeof(header)) {
+        fprintf(stderr, "Can't read %s\n", file);
+        exit(1);
+    }
+    bytes = CKPT_HEADER + ((size_t) (header.m + 2*header.halo)*header.pitch
+          + WORLD_LEAD)*sizeof(word_t);
+    base = mmap(NULL, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "Can't map %s\n", file);
+        exit(1);
+    }
+    
+    rows = base + CKPT_HEADER/sizeof(word_t) + WORLD_LEAD + 1;
+    for (i = 0; i < world_m; i++)
+        memcpy(Row(wp, i), rows + (size_t) (i + header.halo)*header.pitch,
+              W*sizeof(word_t));
+    munmap(base, bytes);
+}  /* Read_checkpoint */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Write_checkpoint
+ * Purpose:    Write a snapshot to the checkpoint file (see note 17)
+ * In args:    snap
+ * In globals: ckpt_file, world_m, n, pitch, halo, rule_birth,
+ *             rule_survive
+ *
+ * Note:       This runs on the writer thread.  The checkpoint goes to
+ *             a file next to ckpt_file, which is then renamed over it,
+ *             so ckpt_file always holds a whole checkpoint.  A failed
+ *             checkpoint is reported, and the run goes on.
+ */
+void Write_checkpoint(Snapshot_t *snap) {
+    char tmp_name[MAX_TITLE];
+    char page[CKPT_HEADER];
+    Ckpt_header_t *header = (Ckpt_header_t*) page;
+    size_t bytes = ((size_t) (world_m + 2*halo)*pitch + WORLD_LEAD)
+          *sizeof(word_t);
+    const char *data = (const char*) (snap->world - WORLD_LEAD);
+    ssize_t done;
+    size_t off;
+    int fd, failed;
+    
+    memset(page, 0, CKPT_HEADER);
+    memcpy(header->magic, CKPT_MAGIC, sizeof(header->magic));
+    header->m = world_m;
+    header->n = n;
+    header->pitch = pitch;
+    header->halo = halo;
+    header->gen = snap->gen;
+    header->live = snap->live;
+    header->birth = rule_birth;
+    header->survive = rule_survive;
+    
+    snprintf(tmp_name, MAX_TITLE, "%s.tmp", ckpt_file);
+    fd = open(tmp_name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || write(fd, page, CKPT_HEADER) != CKPT_HEADER) {
+        fprintf(stderr, "Can't write checkpoint %s\n", tmp_name);
+        if (fd >= 0) close(fd);
+        return;
+    }
+    for (off = 0; off < bytes; off += done) {
+        done = write(fd, data + off, bytes - off);
+        if (done <= 0) {
+            fprintf(stderr, "Can't write checkpoint %s\n", tmp_name);
+            close(fd);
+            return;
+        }
+    }
+    failed = fsync(fd) != 0;
+    failed |= close(fd) != 0;
+    if (failed || rename(tmp_name, ckpt_file) != 0)
+        fprintf(stderr, "Can't write checkpoint %s\n", ckpt_file);
+}  /* Write_checkpoint */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Snapshot_due
+ * Purpose:    Find out what has to be done with a generation
+ * In args:    gen
+ * In globals: out_every, ckpt_every
+ * Ret val:    SNAP_PRINT if it's printed, plus SNAP_CHECKPOINT if it's
+ *             checkpointed
+ */
+int Snapshot_due(int gen) {
+    int what = 0;
+    
+    if (out_every > 0 && gen % out_every == 0)
+        what |= SNAP_PRINT;
+    if (ckpt_every > 0 && gen % ckpt_every == 0)
+        what |= SNAP_CHECKPOINT;
+    return what;
+}  /* Snapshot_due */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Parse_ensemble
+ * Purpose:    Make the list of worlds for -M (see note 20)
+ * In args:    str:  <seeds>[/<probs>], where seeds is a comma separated
+ *             list of seeds and ranges of them like 1-1000, and probs
+ *             a comma separated list of probabilities
+ * Out globals: ens_worlds, ens_count, ens_prompt
+ * Ret val:    1, or 0 if str isn't a list of worlds
+ *
+ * Note:       Each prob is played with each seed, the seeds varying
+ *             fastest.  Without probs the worlds' thresholds are set
+ *             once the prob has been asked for.
+ */
+int Parse_ensemble(const char str[]) {
+    uint64_t first, last, seed, *seeds = NULL;
+    double prob, *probs = NULL;
+    long seed_count = 0, prob_count = 0, alloc = 0, k, l;
+    const char *p = str;
+    char *end;
+    
+    do {
+        first = last = strtoull(p, &end, 10);
+        if (end == p) return 0;
+        if (*end == '-') {
+            p = end + 1;
+            last = strtoull(p, &end, 10);
+            if (end == p || last < first) return 0;
+        }
+        for (seed = first; seed_count <= ENS_MAX; seed++) {
+            if (seed_count == alloc) {
+                alloc = 2*alloc + 16;
+                seeds = realloc(seeds, alloc*sizeof(uint64_t));
+            }
+            seeds[seed_count++] = seed;
+            if (seed == last) break;
+        }
+        p = end + 1;
+    } while (*end == ',');
+    
+    ens_prompt = *end != '/';
+    if (*end == '/') {
+        alloc = 0;
+        do {
+            prob = strtod(p, &end);
+            if (end == p || prob < 0.0 || prob > 1.0) return 0;
+            if (prob_count == alloc) {
+                alloc = 2*alloc + 16;
+                probs = realloc(probs, alloc*sizeof(double));
+            }
+            probs[prob_count++] = prob;
+            p = end + 1;
+        } while (*end == ',');
+    } else {
+        prob_count = 1;
+    }
+    if (*end != '\0' || seed_count*prob_count > ENS_MAX) return 0;
+    
+    ens_count = seed_count*prob_count;
+    ens_worlds = calloc(ens_count, sizeof(Ens_world_t));
+    for (k = 0; k < prob_count; k++)
+        for (l = 0; l < seed_count; l++) {
+            ens_worlds[k*seed_count + l].seed = seeds[l];
+            if (!ens_prompt)
+                ens_worlds[k*seed_count + l].threshold =
+                      Life_prob_threshold(probs[k]);
+        }
+    free(seeds);
+    free(probs);
+    return 1;
+}  /* Parse_ensemble */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Play_ensemble
+ * Purpose:    Play every world of the ensemble, and print what became
+ *             of each of them (see note 20)
+ * In globals: ens_count, ens_prompt, thread_count, gen_threshold
+ * In/out globals: ens_worlds
+ */
+void Play_ensemble(void) {
+    pthread_t *handles = malloc(thread_count*sizeof(pthread_t));
+    long thread, k;
+    
+    if (ens_prompt) {
+        Get_prob("What's the prob that a cell is alive?");
+        for (k = 0; k < ens_count; k++)
+            ens_worlds[k].threshold = gen_threshold;
+    }
+    
+    for (thread = 0; thread < thread_count; thread++)
+        pthread_create(&handles[thread], NULL, Ens_thread, (void*) thread);
+    for (thread = 0; thread < thread_count; thread++)
+        pthread_join(handles[thread], NULL);
+    
+    printf("world,seed,prob,gens,live,extinct,period\n");
+    for (k = 0; k < ens_count; k++)
+        printf("%ld,%llu,%g,%d,%ld,%d,%d\n", k,
+              (unsigned long long) ens_worlds[k].seed,
+              ens_worlds[k].threshold/18446744073709551616.0,
+              ens_worlds[k].gens, ens_worlds[k].live,
+              ens_worlds[k].extinct, ens_worlds[k].period);
+    free(handles);
+    free(ens_worlds);
+}  /* Play_ensemble */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Ens_thread
+ * Purpose:    Thread function for an ensemble:  play worlds until
+ *             there are none left
+ * In globals: ens_count, m, n, rule_name, cycle_ring
+ * In/out globals: ens_next, ens_worlds
+ * Return val: NULL
+ *
+ * Note:       The thread plays every world it gets in the same Life_t.
+ */
+void *Ens_thread(void* ignore) {
+    Life_t *life;
+    uint64_t *hashes;
+    int ring = cycle_ring > 0 ? cycle_ring : ENS_RING, err;
+    long k;
+    
+    (void) ignore;
+    err = Life_create(&life, m, n, rule_name, "cpu");
+    if (err != LIFE_OK) {
+        fprintf(stderr, "Can't make an ensemble world:  %s\n",
+              Life_strerror(err));
+        exit(1);
+    }
+    hashes = malloc(ring*sizeof(uint64_t));
+    while ((k = atomic_fetch_add(&ens_next, 1)) < ens_count)
+        Ens_play(&ens_worlds[k], life, hashes, ring);
+    free(hashes);
+    Life_destroy(life);
+    
+    return NULL;
+}  /* Ens_thread */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Ens_play
+ * Purpose:    Play one world of an ensemble for up to max_gens
+ *             generations
+ * In args:    ring:  the number of hashes in hashes
+ * In/out args: world:  gets its seed and threshold, and returns the
+ *             summary
+ *             life:  the library's world to play it in
+ *             hashes:  scratch for the hashes of the last generations
+ * In globals: max_gens, rule_birth
+ *
+ * Note:       Once a generation's hash matches one of the last ring
+ *             generations', the world is in a cycle, and whole periods
+ *             are skipped, as with -C.  Without B0 a world whose cells
+ *             have all died stays dead, so it stops there.
+ */
+void Ens_play(Ens_world_t *world, Life_t *life, uint64_t hashes[],
+      int ring) {
+    int gen = 0, d;
+    uint64_t hash;
+    
+    Life_seed(life, world->seed, world->threshold);
+    hashes[0] = Life_hash(life);
+    world->extinct = -1;
+    world->period = 0;
+    
+    while (gen < max_gens && (Life_live(life) > 0 || (rule_birth & 1))) {
+        Life_step(life, 1);
+        gen++;
+        if (world->period == 0) {
+            hash = Life_hash(life);
+            for (d = 1; d <= ring && d <= gen; d++)
+                if (hashes[(gen - d) % ring] == hash) {
+                    world->period = d;
+                    gen += (max_gens - gen)/d*d;
+                    break;
+                }
+            hashes[gen % ring] = hash;
+        }
+    }
+    
+    world->gens = gen;
+    world->live = Life_live(life);
+    if (world->live == 0) {
+        world->extinct = gen;
+        if (!(rule_birth & 1)) world->period = 1;
+    }
+}  /* Ens_play */
+
+
+#ifdef USE_MPI
+/*---------------------------------------------------------------------
+ * Function:   Start_mpi
+ * Purpose:    Start MPI, and find out which process this is
+ * In/out args: argc_p, argv_p
+ * Out globals: mpi_rank, mpi_size
+ *
+ * Note:       Only one thread calls MPI at a time:  the last one at a
+ *             barrier, or the one in Wait_halo.
+ */
+void Start_mpi(int *argc_p, char **argv_p[]) {
+    int provided;
+    
+    MPI_Init_thread(argc_p, argv_p, MPI_THREAD_SERIALIZED, &provided);
+    if (provided < MPI_THREAD_SERIALIZED) {
+        fprintf(stderr, "MPI doesn't support threads\n");
+        MPI_Abort(MPI_COMM_WORLD, 1);
+    }
+    MPI_Comm_rank(MPI_COMM_WORLD, &mpi_rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &mpi_size);
+}  /* Start_mpi */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Split_world
+ * Purpose:    Give each process a band of rows (see note 10)
+ * In globals: world_m, mpi_rank, mpi_size, depth, pitch, view_row,
+ *             view_m
+ * Out globals: m, row0, halo, proc_row0, proc_rows, view_row0,
+ *             view_rows, row_type, track_active, halo_mutex
+ *
+ * Note:       The bands' sizes differ by at most one.  Each band has to
+ *             have at least halo rows, since the ghost rows only come
+ *             from the processes next to it.
+ */
+void Split_world(void) {
+    int k;
+    
+    halo = depth;
+    track_active = 0;
+    proc_row0 = malloc((mpi_size + 1)*sizeof(int));
+    proc_rows = malloc(mpi_size*sizeof(int));
+    for (k = 0; k <= mpi_size; k++)
+        proc_row0[k] = (long) k*world_m/mpi_size;
+    for (k = 0; k < mpi_size; k++)
+        proc_rows[k] = proc_row0[k+1] - proc_row0[k];
+    if (proc_rows[0] < halo) {
+        if (mpi_rank == 0)
+            fprintf(stderr, "Each of the %d processes needs at least %d rows\n",
+                  mpi_size, halo);
+        MPI_Finalize();
+        exit(1);
+    }
+    row0 = proc_row0[mpi_rank];
+    m = proc_rows[mpi_rank];
+    view_row0 = malloc(mpi_size*sizeof(int));
+    view_rows = malloc(mpi_size*sizeof(int));
+    for (k = 0; k < mpi_size; k++) {
+        view_row0[k] = proc_row0[k] > view_row ? proc_row0[k] : view_row;
+        view_rows[k] = (proc_row0[k+1] < view_row + view_m ?
+              proc_row0[k+1] : view_row + view_m) - view_row0[k];
+        if (view_rows[k] <= 0) {
+            view_row0[k] = proc_row0[k];
+            view_rows[k] = 0;
+        }
+    }
+    
+    MPI_Type_contiguous(pitch, MPI_UINT64_T, &row_type);
+    MPI_Type_commit(&row_type);
+    pthread_mutex_init(&halo_mutex, NULL);
+}  /* Split_world */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Stop_mpi
+ * Purpose:    Free what Split_world allocated, and shut down MPI
+ * In/out globals: proc_row0, proc_rows, view_row0, view_rows, row_type,
+ *             halo_mutex
+ */
+void Stop_mpi(void) {
+    free(proc_row0);
+    free(proc_rows);
+    free(view_row0);
+    free(view_rows);
+    MPI_Type_free(&row_type);
+    pthread_mutex_destroy(&halo_mutex);
+    MPI_Finalize();
+}  /* Stop_mpi */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Start_halo
+ * Purpose:    Start sending this process's first and last halo rows to
+ *             the processes above and below it, and receiving theirs
+ *             into the ghost rows
+ * In/out arg: wp
+ * In globals: m, halo, mpi_rank, mpi_size, row_type
+ * Out globals: halo_requests, halo_ready
+ *
+ * Note:       The rows are sent with their ghost words.  With one
+ *             process it sends to itself, which wraps the world around.
+ */
+void Start_halo(word_t wp[]) {
+    int north = (mpi_rank + mpi_size - 1) % mpi_size;
+    int south = (mpi_rank + 1) % mpi_size;
+    
+    MPI_Irecv(Row(wp, -halo) - 1, halo, row_type, north, HALO_SOUTH,
+          MPI_COMM_WORLD, &halo_requests[0]);
+    MPI_Irecv(Row(wp, m) - 1, halo, row_type, south, HALO_NORTH,
+          MPI_COMM_WORLD, &halo_requests[1]);
+    MPI_Isend(Row(wp, 0) - 1, halo, row_type, north, HALO_NORTH,
+          MPI_COMM_WORLD, &halo_requests[2]);
+    MPI_Isend(Row(wp, m - halo) - 1, halo, row_type, south, HALO_SOUTH,
+          MPI_COMM_WORLD, &halo_requests[3]);
+    atomic_store(&halo_ready, 0);
+}  /* Start_halo */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Wait_halo
+ * Purpose:    Wait for the exchange started by Start_halo to finish
+ * In/out globals: halo_requests, halo_ready
+ *
+ * Note:       Any thread can call it.  The first one waits, under
+ *             halo_mutex;  after that it returns right away.
+ */
+void Wait_halo(void) {
+    if (atomic_load_explicit(&halo_ready, memory_order_acquire))
+        return;
+    pthread_mutex_lock(&halo_mutex);
+    if (!atomic_load_explicit(&halo_ready, memory_order_relaxed)) {
+        MPI_Waitall(4, halo_requests, MPI_STATUSES_IGNORE);
+        atomic_store_explicit(&halo_ready, 1, memory_order_release);
+    }
+    pthread_mutex_unlock(&halo_mutex);
+}  /* Wait_halo */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Gather_world
+ * Purpose:    Collect the processes' rows into one world on process 0
+ * In args:    wp:  this process's rows
+ *             view:  only collect the rows of the window
+ * Out arg:    full:  on process 0, a buffer of world_m + 2*halo rows;
+ *             ignored on the others
+ * In globals: m, row0, mpi_rank, proc_rows, proc_row0, view_rows,
+ *             view_row0, row_type
+ */
+void Gather_world(word_t wp[], word_t full[], int view) {
+    if (view)
+        MPI_Gatherv(Row(wp, view_row0[mpi_rank] - row0) - 1,
+              view_rows[mpi_rank], row_type,
+              full == NULL ? NULL : Row(full, 0) - 1, view_rows, view_row0,
+              row_type, 0, MPI_COMM_WORLD);
+    else
+        MPI_Gatherv(Row(wp, 0) - 1, m, row_type,
+              full == NULL ? NULL : Row(full, 0) - 1, proc_rows, proc_row0,
+              row_type, 0, MPI_COMM_WORLD);
+}  /* Gather_world */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Scatter_world
+ * Purpose:    Hand out the rows of a world on process 0 to the
+ *             processes that own them
+ * In args:    full:  on process 0, a buffer of world_m + 2*halo rows;
+ *             ignored on the others
+ * Out arg:    wp:  this process's rows
+ * In globals: m, proc_rows, proc_row0, row_type
+ */
+void Scatter_world(word_t full[], word_t wp[]) {
+    MPI_Scatterv(full == NULL ? NULL : Row(full, 0) - 1, proc_rows,
+          proc_row0, row_type, Row(wp, 0) - 1, m, row_type, 0,
+          MPI_COMM_WORLD);
+}  /* Scatter_world */
+#endif
+
+
+#ifdef USE_TRACE
+/*---------------------------------------------------------------------
+ * Function:   Trace_setup
+ * Purpose:    Allocate the threads' counters and start the trace clock
+ *             (see note 16)
+ * In globals: thread_count, engine
+ * Out globals: traces, trace_zero
+ *
+ * Note:       Slot thread_count is the writer's.  The engines that
+ *             run on the main thread use slot 0, like worker 0.
+ */
+void Trace_setup(void) {
+    int k;
+    
+    traces = aligned_alloc(CACHE_LINE, (thread_count + 1)*sizeof(Trace_t));
+    memset(traces, 0, (thread_count + 1)*sizeof(Trace_t));
+    for (k = 0; k <= thread_count; k++)
+        traces[k].perf_fd[0] = traces[k].perf_fd[1] = -1;
+    clock_gettime(CLOCK_MONOTONIC, &trace_zero);
+    if (engine != ENGINE_CPU && engine != ENGINE_AUTO)
+        Trace_thread(0);
+}  /* Trace_setup */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Trace_thread
+ * Purpose:    Start tracing the calling thread
+ * In args:    rank:  its slot in traces
+ * In globals: trace_file
+ * Out globals: trace_rank, traces[rank]
+ *
+ * Note:       The hardware counters count this thread from now on.
+ *             If perf_event_open isn't allowed, they're left at -1.
+ */
+void Trace_thread(int rank) {
+    Trace_t *trace = &traces[rank];
+    
+    trace_rank = rank;
+    trace->perf_fd[0] = Perf_open(PERF_COUNT_HW_CPU_CYCLES);
+    trace->perf_fd[1] = Perf_open(PERF_COUNT_HW_CACHE_MISSES);
+    if (trace_file != NULL)
+        trace->events = malloc(TRACE_EVENTS*sizeof(Trace_event_t));
+}  /* Trace_thread */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Perf_open
+ * Purpose:    Open a hardware counter for the calling thread
+ * In args:    config:  which PERF_COUNT_HW_ counter
+ * Ret val:    Its file descriptor, or -1
+ */
+int Perf_open(uint64_t config) {
+    struct perf_event_attr attr;
+    
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}  /* Perf_open */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Trace_now
+ * Purpose:    Read the trace clock
+ * In globals: trace_zero
+ * Ret val:    ns since Trace_setup
+ */
+double Trace_now(void) {
+    struct timespec now;
+    
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return 1.0e9*(now.tv_sec - trace_zero.tv_sec)
+          + (now.tv_nsec - trace_zero.tv_nsec);
+}  /* Trace_now */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Trace_span
+ * Purpose:    Record a span of the calling thread's time
+ * In args:    name:  what it was spent on
+ *             start:  when it started, from Trace_now
+ * In/out arg: total:  the counter it's added to
+ * In globals: trace_rank
+ * In/out globals: traces[trace_rank]
+ *
+ * Note:       Once a thread has TRACE_EVENTS spans, later ones are
+ *             only counted, not put in the timeline.
+ */
+void Trace_span(const char *name, double start, double *total) {
+    Trace_t *trace = &traces[trace_rank];
+    double now = Trace_now();
+    Trace_event_t *event;
+    
+    *total += now - start;
+    if (trace->events == NULL) return;
+    if (trace->event_count == TRACE_EVENTS) {
+        trace->dropped++;
+        return;
+    }
+    event = &trace->events[trace->event_count++];
+    event->name = name;
+    event->start = start;
+    event->dur = now - start;
+}  /* Trace_span */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Trace_report
+ * Purpose:    Print each thread's counters on stderr, and write the
+ *             timeline if -Q was given
+ * In globals: thread_count, trace_file, mpi_rank, mpi_size
+ * In/out globals: traces
+ *
+ * Note:       This is called after all the threads are done.  The
+ *             timeline is in the Chrome trace event format, which
+ *             chrome://tracing and Perfetto read.  With MPI each
+ *             process writes its own file, with its rank appended to
+ *             the name.
+ */
+void Trace_report(void) {
+    Trace_t *trace;
+    Trace_event_t *event;
+    char name[MAX_TITLE];
+    FILE *fp;
+    long long count[2];
+    int k, c, e, first = 1;
+    
+    for (k = 0; k <= thread_count; k++) {
+        trace = &traces[k];
+        if (k == thread_count && mpi_rank != 0) break;  /* No writer */
+        for (c = 0; c < 2; c++) {
+            count[c] = -1;
+            if (trace->perf_fd[c] >= 0) {
+                if (read(trace->perf_fd[c], &count[c], sizeof(count[c]))
+                      != sizeof(count[c]))
+                    count[c] = -1;
+                close(trace->perf_fd[c]);
+            }
+        }
+        if (k == thread_count)
+            fprintf(stderr, "[%d] writer:   ", mpi_rank);
+        else
+            fprintf(stderr, "[%d] thread %d:", mpi_rank, k);
+        fprintf(stderr, " compute %.3f ms, spin %.3f ms, park %.3f ms "
+              "(%ld), serial %.3f ms, i/o %.3f ms, tiles %ld (%ld "
+              "skipped), cells %ld, cycles %lld, cache misses %lld\n",
+              1.0e-6*trace->compute_ns, 1.0e-6*trace->spin_ns,
+              1.0e-6*trace->park_ns, trace->parks, 1.0e-6*trace->serial_ns,
+              1.0e-6*trace->io_ns, trace->tiles, trace->skipped,
+              trace->cells, count[0], count[1]);
+        if (trace->dropped > 0)
+            fprintf(stderr, "[%d] %d spans left out of the timeline\n",
+                  mpi_rank, trace->dropped);
+    }
+    if (trace_file == NULL) return;
+    
+    if (mpi_size > 1)
+        snprintf(name, MAX_TITLE, "%s.%d", trace_file, mpi_rank);
+    else
+        snprintf(name, MAX_TITLE, "%s", trace_file);
+    fp = fopen(name, "w");
+    if (fp == NULL) {
+        fprintf(stderr, "Can't write %s\n", name);
+        return;
+    }
+    fprintf(fp, "{\"traceEvents\": [\n");
+    for (k = 0; k <= thread_count; k++) {
+        trace = &traces[k];
+        if (k == thread_count)
+            snprintf(name, MAX_TITLE, "writer");
+        else
+            snprintf(name, MAX_TITLE, "thread %d", k);
+        fprintf(fp, "%s{\"name\": \"thread_name\", \"ph\": \"M\", "
+              "\"pid\": %d, \"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+              first ? "" : ",\n", mpi_rank, k, name);
+        first = 0;
+        for (e = 0; e < trace->event_count; e++) {
+            event = &trace->events[e];
+            fprintf(fp, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %d, "
+                  "\"tid\": %d, \"ts\": %.3f, \"dur\": %.3f}", event->name,
+                  mpi_rank, k, 1.0e-3*event->start, 1.0e-3*event->dur);
+        }
+        free(trace->events);
+    }
+    fprintf(fp, "\n]}\n");
+    fclose(fp);
+}  /* Trace_report */
+#endif
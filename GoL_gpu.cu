@@ -0,0 +1,379 @@
+/* File:     GoL_gpu.cu
+ * Author:   Ray Wang, 20228436
+ * Purpose:  GPU engine for GoL.c (see note 11 there).  Both generations
+ *           stay on the device, in the same bit-packed layout with a
+ *           halo as on the host, and are only copied back when a
+ *           generation is to be printed or the run is over.
+ *
+ * Compile:  nvcc -O3 -c GoL_gpu.cu
+ *           hipcc -O3 -DUSE_HIP -x hip -c GoL_gpu.cu
+ *           and link GoL_gpu.o into GoL.c compiled with -DUSE_CUDA.
+ *
+ * Notes:
+ * 1.  Each thread block computes BLOCK_ROWS rows by BLOCK_WORDS words
+ *     of the next generation.  Its words of the current generation
+ *     and a one-word, one-row halo around them are first loaded into
+ *     shared memory, and each thread then does one word with the same
+ *     bit-sliced adder as the CPU kernels.  The thread that does a
+ *     word also stores the ghost cells that copy it, so the halo of
+ *     the new generation is complete when the kernel finishes.
+ * 2.  Each block adds up its live cells in shared memory, and then
+ *     adds them to the count for its generation in device memory.  A
+ *     kernel whose previous generation had no live cells returns
+ *     right away, so a batch of generations can be launched without
+ *     waiting for the counts, and the buffer holding the last
+ *     generation with live cells isn't overwritten.
+ * 3.  The kernel is a template on the rule's masks (see note 19 in
+ *     GoL.c), instantiated for the rules that have kernels of their
+ *     own on the CPU, so the compiler reduces Life_word to the counts
+ *     the rule uses.  Any other rule runs on the instance with
+ *     B = -1, which takes the masks as args.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#ifdef USE_HIP
+#include <hip/hip_runtime.h>
+#define cudaError_t hipError_t
+#define cudaSuccess hipSuccess
+#define cudaGetErrorString hipGetErrorString
+#define cudaGetDeviceCount hipGetDeviceCount
+#define cudaGetLastError hipGetLastError
+#define cudaMalloc hipMalloc
+#define cudaFree hipFree
+#define cudaMemset hipMemset
+#define cudaMemcpy hipMemcpy
+#define cudaMemcpyHostToDevice hipMemcpyHostToDevice
+#define cudaMemcpyDeviceToHost hipMemcpyDeviceToHost
+#else
+#include <cuda_runtime.h>
+#endif
+
+typedef unsigned long long word_t;
+#define WORD_BITS 64
+
+/* Size of the part of the world each thread block computes */
+#define BLOCK_WORDS 32
+#define BLOCK_ROWS 8
+
+/* Words before row -1 in a buffer, as in GoL.c, so that word 0 of each
+ * row starts a 64-byte line whenever pitch is a multiple of 8
+ */
+#define WORLD_LEAD 7
+
+/* Most generations in a call to Gpu_play */
+#define GPU_BATCH 1024
+
+/* The masks of B3/S23, as in GoL.c */
+#define CONWAY_BIRTH 0x008
+#define CONWAY_SURVIVE 0x00C
+
+#define Check(call) do {                                                  \
+    cudaError_t err_ = (call);                                            \
+    if (err_ != cudaSuccess) {                                            \
+        fprintf(stderr, "GPU error: %s\n", cudaGetErrorString(err_));     \
+        exit(1);                                                          \
+    }                                                                     \
+} while (0)
+
+/* The world on the device */
+static int gm, gn, gW, gpitch;
+static word_t *dev_base[2];     /* What cudaMalloc returned */
+static word_t *dev_world[2];    /* The buffers, laid out as wp in GoL.c */
+static int cur;                 /* dev_world[cur] is the current gen */
+static unsigned long long *dev_live;    /* Live cells after each gen */
+
+/* The kernel for the rule (see note 3) */
+typedef void Kernel_fn(const word_t in[], word_t out[], int m, int n,
+      int W, int pitch, const unsigned long long *prev_live,
+      unsigned long long *live, int birth, int survive);
+static Kernel_fn *gkernel;
+static int gbirth, gsurvive;
+
+extern "C" {
+int  Gpu_start(const uint64_t world[], int m, int n, int W, int pitch,
+      int birth, int survive);
+int  Gpu_play(int gens, long live[]);
+void Gpu_fetch(uint64_t world[]);
+void Gpu_stop(void);
+}
+
+/* Row i of a world on the device, -1 <= i <= m */
+__device__ static inline word_t *Dev_row(word_t wp[], int i, int pitch) {
+    return wp + (size_t) (i+1)*pitch + 1;
+}
+
+/*---------------------------------------------------------------------
+ * Function:   Life_word
+ * Purpose:    Bit-sliced update of a word of cells (see LIFE_WORD in
+ *             GoL.c)
+ * In args:    birth, survive:  the rule's masks, used if B < 0
+ *             nw, no, ne, we, ctr, ea, sw, so, se:  the row above,
+ *             the row and the row below, shifted so that bit k of each
+ *             holds a neighbor of bit k of ctr
+ * Template:   B, S:  the rule's masks, or -1 (see note 3)
+ * Ret val:    The word in the next generation
+ */
+template <int B, int S>
+__device__ static inline word_t Life_word(int birth, int survive,
+      word_t nw, word_t no, word_t ne, word_t we, word_t ctr, word_t ea,
+      word_t sw, word_t so, word_t se) {
+    word_t a0, a1, b0, b1, c0, c1, s0, k1, t1, t2, s1, s2, s3;
+    word_t m[9], born = 0, lives = 0;
+    int k;
+
+    a0 = nw ^ no ^ ne;
+    a1 = (nw & no) | (ne & (nw ^ no));
+    b0 = sw ^ so ^ se;
+    b1 = (sw & so) | (se & (sw ^ so));
+    c0 = we ^ ea;
+    c1 = we & ea;
+    s0 = a0 ^ b0 ^ c0;
+    k1 = (a0 & b0) | (c0 & (a0 ^ b0));
+    t1 = a1 ^ b1 ^ c1;
+    t2 = (a1 & b1) | (c1 & (a1 ^ b1));
+    s1 = t1 ^ k1;
+    s2 = t2 ^ (t1 & k1);
+    if (B >= 0) {
+        birth = B;
+        survive = S;
+    }
+    if (birth == CONWAY_BIRTH && survive == CONWAY_SURVIVE)
+        return s1 & ~s2 & (s0 | ctr);
+
+    /* The minterms of the counts;  s3 is only set by 8 */
+    s3 = t2 & t1 & k1;
+    m[0] = ~(s0 | s1 | s2 | s3);
+    for (k = 1; k < 8; k++)
+        m[k] = (k & 1 ? s0 : ~s0) & (k & 2 ? s1 : ~s1) & (k & 4 ? s2 : ~s2);
+    m[8] = s3;
+#   pragma unroll
+    for (k = 0; k <= 8; k++) {
+        if ((birth >> k) & 1) born |= m[k];
+        if ((survive >> k) & 1) lives |= m[k];
+    }
+    return (born & ~ctr) | (lives & ctr);
+}  /* Life_word */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Store_word
+ * Purpose:    Store word w of a row of the next generation, along with
+ *             the ghost words that copy its cells
+ * In args:    w, W, e:  e = (n-1) % 64 is the last col's bit
+ *             next:  the word
+ * Out arg:    row
+ */
+__device__ static inline void Store_word(word_t row[], int w, int W, int e,
+      word_t next) {
+    row[w] = next;
+    if (w == W-1) row[-1] = ((next >> e) & 1) << (WORD_BITS-1);
+    if (w == 0) row[W] = next & 1;
+}  /* Store_word */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_kernel
+ * Purpose:    Compute the next generation (see notes 1 and 2)
+ * In args:    in:  the current generation
+ *             m, n, W, pitch:  the world's size and layout
+ *             prev_live:  the current generation's live count, or
+ *             NULL if it's known to have live cells
+ *             birth, survive:  the rule, if B < 0
+ * Template:   B, S:  the rule (see note 3)
+ * Out args:   out:  the next generation
+ *             live:  incremented by the next generation's live count
+ */
+template <int B, int S>
+__global__ void Life_kernel(const word_t in[], word_t out[], int m, int n,
+      int W, int pitch, const unsigned long long *prev_live,
+      unsigned long long *live, int birth, int survive) {
+    __shared__ word_t tile[BLOCK_ROWS+2][BLOCK_WORDS+2];
+    __shared__ unsigned long long block_live;
+    int tx = threadIdx.x, ty = threadIdx.y;
+    int w0 = blockIdx.x*BLOCK_WORDS, i0 = blockIdx.y*BLOCK_ROWS;
+    int w = w0 + tx, i = i0 + ty;
+    int e = (n-1) % WORD_BITS;
+    int k, ti, tw, x = tx + 1;
+    const word_t *a, *c, *b;
+    word_t next;
+
+    if (prev_live != NULL && *prev_live == 0) return;
+
+    /* Rows i0-1 to i0+BLOCK_ROWS and words w0-1 to w0+BLOCK_WORDS */
+    for (k = ty*BLOCK_WORDS + tx; k < (BLOCK_ROWS+2)*(BLOCK_WORDS+2);
+          k += BLOCK_ROWS*BLOCK_WORDS) {
+        ti = i0 - 1 + k/(BLOCK_WORDS+2);
+        tw = w0 - 1 + k%(BLOCK_WORDS+2);
+        tile[k/(BLOCK_WORDS+2)][k%(BLOCK_WORDS+2)] = ti <= m && tw <= W
+              ? Dev_row((word_t*) in, ti, pitch)[tw] : 0;
+    }
+    if (tx == 0 && ty == 0) block_live = 0;
+    __syncthreads();
+
+    if (i < m && w < W) {
+        a = tile[ty];
+        c = tile[ty+1];
+        b = tile[ty+2];
+        if (w < W-1)
+            next = Life_word<B, S>(birth, survive,
+                  (a[x] << 1) | (a[x-1] >> (WORD_BITS-1)), a[x],
+                  (a[x] >> 1) | (a[x+1] << (WORD_BITS-1)),
+                  (c[x] << 1) | (c[x-1] >> (WORD_BITS-1)), c[x],
+                  (c[x] >> 1) | (c[x+1] << (WORD_BITS-1)),
+                  (b[x] << 1) | (b[x-1] >> (WORD_BITS-1)), b[x],
+                  (b[x] >> 1) | (b[x+1] << (WORD_BITS-1)));
+        else {
+            /* The east neighbor of col n-1 is col 0, in the ghost word */
+            next = Life_word<B, S>(birth, survive,
+                  (a[x] << 1) | (a[x-1] >> (WORD_BITS-1)), a[x],
+                  (a[x] >> 1) | ((a[x+1] & 1) << e),
+                  (c[x] << 1) | (c[x-1] >> (WORD_BITS-1)), c[x],
+                  (c[x] >> 1) | ((c[x+1] & 1) << e),
+                  (b[x] << 1) | (b[x-1] >> (WORD_BITS-1)), b[x],
+                  (b[x] >> 1) | ((b[x+1] & 1) << e));
+            if (e != WORD_BITS-1)
+                next &= ((word_t) 2 << e) - 1;
+        }
+
+        Store_word(Dev_row(out, i, pitch), w, W, e, next);
+        if (i == 0) Store_word(Dev_row(out, m, pitch), w, W, e, next);
+        if (i == m-1) Store_word(Dev_row(out, -1, pitch), w, W, e, next);
+        if (next != 0) atomicAdd(&block_live, __popcll(next));
+    }
+    __syncthreads();
+
+    if (tx == 0 && ty == 0 && block_live != 0)
+        atomicAdd(live, block_live);
+}  /* Life_kernel */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Pick_kernel
+ * Purpose:    Find the instance of Life_kernel for a rule
+ * In args:    birth, survive
+ * Ret val:    The kernel
+ */
+static Kernel_fn *Pick_kernel(int birth, int survive) {
+    static const struct {
+        int birth, survive;
+        Kernel_fn *kernel;
+    } kernels[] = {
+        {CONWAY_BIRTH, CONWAY_SURVIVE,
+              Life_kernel<CONWAY_BIRTH, CONWAY_SURVIVE>},
+        {0x048, 0x00C, Life_kernel<0x048, 0x00C>},      /* B36/S23 */
+        {0x1C8, 0x1D8, Life_kernel<0x1C8, 0x1D8>},      /* B3678/S34678 */
+        {0x004, 0x000, Life_kernel<0x004, 0x000>},      /* B2/S */
+        {0x008, 0x1FF, Life_kernel<0x008, 0x1FF>},      /* B3/S012345678 */
+        {0x008, 0x03E, Life_kernel<0x008, 0x03E>},      /* B3/S12345 */
+        {0x0AA, 0x0AA, Life_kernel<0x0AA, 0x0AA>},      /* B1357/S1357 */
+    };
+    size_t k;
+
+    for (k = 0; k < sizeof(kernels)/sizeof(kernels[0]); k++)
+        if (kernels[k].birth == birth && kernels[k].survive == survive)
+            return kernels[k].kernel;
+    return Life_kernel<-1, -1>;
+}  /* Pick_kernel */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Gpu_start
+ * Purpose:    Copy generation 0 to the device
+ * In args:    world:  generation 0, laid out as wp in GoL.c with its
+ *             halo filled in
+ *             m, n, W, pitch
+ *             birth, survive:  the rule, which has no B0
+ * Ret val:    0, or -1 if there's no device
+ */
+int Gpu_start(const uint64_t world[], int m, int n, int W, int pitch,
+      int birth, int survive) {
+    size_t words = (size_t) (m+2)*pitch;
+    int devices = 0, k;
+
+    if (cudaGetDeviceCount(&devices) != cudaSuccess || devices == 0)
+        return -1;
+    gm = m;
+    gn = n;
+    gW = W;
+    gpitch = pitch;
+    gbirth = birth;
+    gsurvive = survive;
+    gkernel = Pick_kernel(birth, survive);
+    for (k = 0; k < 2; k++) {
+        Check(cudaMalloc((void**) &dev_base[k],
+              (words + WORLD_LEAD)*sizeof(word_t)));
+        Check(cudaMemset(dev_base[k], 0,
+              (words + WORLD_LEAD)*sizeof(word_t)));
+        dev_world[k] = dev_base[k] + WORLD_LEAD;
+    }
+    Check(cudaMemcpy(dev_world[0], world, words*sizeof(word_t),
+          cudaMemcpyHostToDevice));
+    Check(cudaMalloc((void**) &dev_live,
+          GPU_BATCH*sizeof(unsigned long long)));
+    cur = 0;
+
+    return 0;
+}  /* Gpu_start */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Gpu_play
+ * Purpose:    Compute up to gens more generations on the device
+ * In args:    gens:  at most GPU_BATCH
+ * Out arg:    live:  live[t] is the live count after t+1 generations
+ * Ret val:    The number of generations computed before every cell
+ *             died:  gens if the last one has live cells
+ *
+ * Note:       All the kernels are launched before the counts are
+ *             copied back, so there's one wait per call.  After the
+ *             call the current generation is the last one with live
+ *             cells (see note 2).
+ */
+int Gpu_play(int gens, long live[]) {
+    unsigned long long counts[GPU_BATCH];
+    dim3 block(BLOCK_WORDS, BLOCK_ROWS);
+    dim3 grid((gW + BLOCK_WORDS - 1)/BLOCK_WORDS,
+          (gm + BLOCK_ROWS - 1)/BLOCK_ROWS);
+    int t, done;
+
+    if (gens > GPU_BATCH) gens = GPU_BATCH;
+    Check(cudaMemset(dev_live, 0, gens*sizeof(unsigned long long)));
+    for (t = 0; t < gens; t++)
+        gkernel<<<grid, block>>>(dev_world[(cur + t) % 2],
+              dev_world[(cur + t + 1) % 2], gm, gn, gW, gpitch,
+              t == 0 ? NULL : dev_live + t-1, dev_live + t, gbirth, gsurvive);
+    Check(cudaGetLastError());
+    Check(cudaMemcpy(counts, dev_live, gens*sizeof(unsigned long long),
+          cudaMemcpyDeviceToHost));
+
+    for (done = 0; done < gens && counts[done] > 0; done++)
+        ;
+    for (t = 0; t < gens; t++)
+        live[t] = counts[t];
+    cur = (cur + done) % 2;
+
+    return done;
+}  /* Gpu_play */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Gpu_fetch
+ * Purpose:    Copy the current generation back to the host
+ * Out arg:    world:  laid out as wp in GoL.c
+ */
+void Gpu_fetch(uint64_t world[]) {
+    Check(cudaMemcpy(world, dev_world[cur],
+          (size_t) (gm+2)*gpitch*sizeof(word_t), cudaMemcpyDeviceToHost));
+}  /* Gpu_fetch */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Gpu_stop
+ * Purpose:    Free the device's buffers
+ */
+void Gpu_stop(void) {
+    Check(cudaFree(dev_base[0]));
+    Check(cudaFree(dev_base[1]));
+    Check(cudaFree(dev_live));
+}  /* Gpu_stop */
@@ -0,0 +1,935 @@
+/* File:     GoL_lib.c
+ * Author:   Ray Wang, 20228436
+ * Purpose:  Game of Life library (see GoL_lib.h):  play Life-like
+ *           rules on toroidal worlds that are passed around as
+ *           handles, with no globals, so one program can play as many
+ *           of them as it likes.  It has the word kernels of GoL.c's
+ *           cpu engine, which GoL.c's tiles call through
+ *           Life_get_kernel, and GoL.c plays its ensembles (-M) with
+ *           it.
+ *
+ * Compile:  gcc -O3 -c GoL_lib.c
+ *           and link GoL_lib.o into the program, or put GoL_lib.c on
+ *           the command line that compiles GoL.c.
+ *
+ * Notes:
+ * 1.  The world is stored as in GoL.c (see note 2 there):  each row is
+ *     W = ceil(n/64) words with a ghost word on each side, which holds
+ *     the cell on the other side of the torus.  There are no ghost
+ *     rows;  row -1 is row m-1 and row m is row 0.
+ * 2.  A row is only recomputed if it or the row above or below it
+ *     changed in the last generation:  Life_active with the rows as
+ *     tiles of a single column, which is the test GoL.c makes for its
+ *     tiles (note 7 there).  A row that isn't recomputed is still right in the
+ *     other buffer, which has the generation before, since it didn't
+ *     change in that generation either.  The live count and hash of
+ *     each row are kept with it, so the world's are sums over the
+ *     rows.  If no row changed, the world is a still life, and
+ *     Life_step just counts the rest of the generations.
+ * 3.  The hash of a world is the same as GoL.c's (note 14 there), so
+ *     the hashes of a world in the library and in GoL.c agree.
+ * 4.  The kernels (see notes 4 and 19 in GoL.c) get the row length and
+ *     the rule as args, so the only state they have is the rows
+ *     they're given, and a Life_step and a generation of GoL.c's cpu
+ *     engine run the same code on every word.  Life_get_kernel picks
+ *     the one specialized to the rule, if there is one, for an
+ *     instruction set, and Life_create picks it for the widest one
+ *     the CPU supports.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "GoL_lib.h"
+
+typedef uint64_t word_t;
+#define WORD_BITS 64
+
+/* The masks of B3/S23, as in GoL.c */
+#define CONWAY_BIRTH 0x008
+#define CONWAY_SURVIVE 0x00C
+
+/* A rule with kernels of its own (see note 19 in GoL.c) */
+typedef struct {
+    const char *name;
+    int birth, survive;
+    Life_kernel_t *kernel[3];   /* In the order of kernel_isas */
+} Rule_t;
+
+/* Largest number of rows or columns */
+#define LIFE_MAX_SIDE (1 << 30)
+
+struct Life_s {
+    int m, n, W;            /* Rows, cols, and words in each row */
+    int pitch;              /* Words from one row to the next */
+    int birth, survive;     /* The rule */
+    Life_kernel_t *kernel;  /* Its kernel, for the widest ISA */
+    long gen, live;
+    uint64_t hash;
+    int still;              /* No row changed in the last generation */
+    word_t *buf[2];         /* buf[cur] has the current generation */
+    int cur;
+    unsigned char *changed[2];  /* changed[cur][i]:  row i changed in
+                                   the last generation */
+    long *row_live;         /* Live cells in each row */
+    uint64_t *row_hash;     /* and its hash */
+};
+
+static inline word_t *Row(const Life_t *life, int b, int i);
+static void Put_life_cell(void *arg, int i, int j);
+static void Finish_row(Life_t *life, int i);
+static void Start_world(Life_t *life);
+static void Next_gen(Life_t *life);
+static long Next_row(const Life_t *life, const word_t above[],
+      const word_t row[], const word_t below[], word_t out[]);
+static inline word_t Next_word(const word_t above[], const word_t row[],
+      const word_t below[], int w, int birth, int survive);
+static inline word_t Next_last_word(const word_t above[],
+      const word_t row[], const word_t below[], int W, int n, int birth,
+      int survive);
+
+
+/*---------------------------------------------------------------------
+ * Function:   Row
+ * Purpose:    Get row i of buffer b of a world, 0 <= i < m
+ */
+static inline word_t *Row(const Life_t *life, int b, int i) {
+    return life->buf[b] + (size_t) i*life->pitch + 1;
+}  /* Row */
+
+
+/*---------------------------------------------------------------------
+ * Macro:      LIFE_WORD
+ * Purpose:    Bit-sliced update of a word (or vector of words) of cells
+ * In args:    birth, survive:  the rule's masks (see note 19 in GoL.c)
+ *             nw, no, ne:  the row above shifted east, unshifted, and
+ *                shifted west, so that bit k of each holds a neighbor
+ *                of bit k of ctr
+ *             we, ea:  the current row shifted east and west
+ *             sw, so, se:  the row below, shifted like the row above
+ *             ctr:  the current cells
+ * Out arg:    next:  the cells of the next generation
+ * Types:      T is the type of the args:  word_t or a GCC vector of
+ *             word_t, which supports the same bitwise operators
+ *
+ * Note:       The eight neighbors are summed into a 4-bit count
+ *             (s3 s2 s1 s0) with full adders;  s3 is only set by a
+ *             count of 8.  For B3/S23 a cell is alive in the next
+ *             generation iff the count is 3, or the count is 2 and the
+ *             cell is alive:  s1 & ~s2 & (s0|ctr), and s3 isn't
+ *             needed.  Other rules are a sum of the minterms of the
+ *             counts in their masks (RULE_WORD).  When birth and
+ *             survive are constants the compiler drops the other
+ *             minterms, and whichever of the two branches isn't taken.
+ */
+#define FULL_ADD(T, sum, carry, x, y, z) do {                             \
+    T fa_t_ = (x) ^ (y);                                                  \
+    (sum) = fa_t_ ^ (z);                                                  \
+    (carry) = ((x) & (y)) | (fa_t_ & (z));                                \
+} while (0)
+
+/* All ones if count k is in a rule's mask, else 0 */
+#define RULE_MASK(mask, k) ((word_t) 0 - (((mask) >> (k)) & 1))
+
+#define RULE_SUM(mask, m0, m1, m2, m3, m4, m5, m6, m7, m8)                \
+    (((m0) & RULE_MASK(mask, 0)) | ((m1) & RULE_MASK(mask, 1))            \
+     | ((m2) & RULE_MASK(mask, 2)) | ((m3) & RULE_MASK(mask, 3))          \
+     | ((m4) & RULE_MASK(mask, 4)) | ((m5) & RULE_MASK(mask, 5))          \
+     | ((m6) & RULE_MASK(mask, 6)) | ((m7) & RULE_MASK(mask, 7))          \
+     | ((m8) & RULE_MASK(mask, 8)))
+
+#define RULE_WORD(T, next, birth, survive, s0, s1, s2, s3, ctr) do {      \
+    T m0_, m1_, m2_, m3_, m4_, m5_, m6_, m7_;                             \
+    m0_ = ~((s0) | (s1) | (s2) | (s3));                                   \
+    m1_ = (s0) & ~(s1) & ~(s2);                                           \
+    m2_ = ~(s0) & (s1) & ~(s2);                                           \
+    m3_ = (s0) & (s1) & ~(s2);                                            \
+    m4_ = ~(s0) & ~(s1) & (s2);                                           \
+    m5_ = (s0) & ~(s1) & (s2);                                            \
+    m6_ = ~(s0) & (s1) & (s2);                                            \
+    m7_ = (s0) & (s1) & (s2);                                             \
+    (next) = (RULE_SUM(birth, m0_, m1_, m2_, m3_, m4_, m5_, m6_, m7_, s3) \
+              & ~(ctr))                                                   \
+          | (RULE_SUM(survive, m0_, m1_, m2_, m3_, m4_, m5_, m6_, m7_, s3)\
+              & (ctr));                                                   \
+} while (0)
+
+#define LIFE_WORD(T, birth, survive, next, nw, no, ne, we, ctr, ea,       \
+      sw, so, se) do {                                                    \
+    T a0_, a1_, b0_, b1_, c0_, c1_, s0_, k1_, t1_, t2_, s1_, s2_, s3_;    \
+    FULL_ADD(T, a0_, a1_, nw, no, ne);                                    \
+    FULL_ADD(T, b0_, b1_, sw, so, se);                                    \
+    c0_ = (we) ^ (ea);                                                    \
+    c1_ = (we) & (ea);                                                    \
+    FULL_ADD(T, s0_, k1_, a0_, b0_, c0_);                                 \
+    FULL_ADD(T, t1_, t2_, a1_, b1_, c1_);                                 \
+    s1_ = t1_ ^ k1_;                                                      \
+    s2_ = t2_ ^ (t1_ & k1_);                                              \
+    if ((birth) == CONWAY_BIRTH && (survive) == CONWAY_SURVIVE) {         \
+        (next) = s1_ & ~s2_ & (s0_ | (ctr));                              \
+    } else {                                                              \
+        s3_ = t2_ & t1_ & k1_;                                            \
+        RULE_WORD(T, next, birth, survive, s0_, s1_, s2_, s3_, ctr);      \
+    }                                                                     \
+} while (0)
+
+
+/*---------------------------------------------------------------------
+ * Function:   Next_word
+ * Purpose:    Compute word w of a row of the next generation
+ * In args:    above, row, below:  rows i-1, i, i+1 of the current gen
+ *             w:  word number, 0 <= w < W
+ *             birth, survive:  the rule
+ * Ret val:    Word w of row i of the next generation
+ *
+ * Note:       This is only right for w < W-1;  see Next_last_word.
+ */
+static inline word_t Next_word(const word_t above[], const word_t row[],
+      const word_t below[], int w, int birth, int survive) {
+    word_t next;
+
+    LIFE_WORD(word_t, birth, survive, next,
+          (above[w] << 1) | (above[w-1] >> (WORD_BITS-1)), above[w],
+          (above[w] >> 1) | (above[w+1] << (WORD_BITS-1)),
+          (row[w] << 1) | (row[w-1] >> (WORD_BITS-1)), row[w],
+          (row[w] >> 1) | (row[w+1] << (WORD_BITS-1)),
+          (below[w] << 1) | (below[w-1] >> (WORD_BITS-1)), below[w],
+          (below[w] >> 1) | (below[w+1] << (WORD_BITS-1)));
+    return next;
+}  /* Next_word */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Next_last_word
+ * Purpose:    Compute word W-1 of a row of the next generation
+ * In args:    above, row, below:  rows i-1, i, i+1 of the current gen
+ *             W, n:  words and cols in a row
+ *             birth, survive:  the rule
+ * Ret val:    Word W-1 of row i of the next generation, with the bits
+ *             past column n-1 cleared
+ *
+ * Note:       The east neighbor of column n-1 is bit 0 of the east
+ *             ghost word, which has to be moved to bit (n-1)%64.
+ */
+static inline word_t Next_last_word(const word_t above[],
+      const word_t row[], const word_t below[], int W, int n, int birth,
+      int survive) {
+    int w = W-1, e = (n-1) % WORD_BITS;
+    word_t next;
+
+    LIFE_WORD(word_t, birth, survive, next,
+          (above[w] << 1) | (above[w-1] >> (WORD_BITS-1)), above[w],
+          (above[w] >> 1) | ((above[w+1] & 1) << e),
+          (row[w] << 1) | (row[w-1] >> (WORD_BITS-1)), row[w],
+          (row[w] >> 1) | ((row[w+1] & 1) << e),
+          (below[w] << 1) | (below[w-1] >> (WORD_BITS-1)), below[w],
+          (below[w] >> 1) | ((below[w+1] & 1) << e));
+    if (e != WORD_BITS-1)
+        next &= ((word_t) 2 << e) - 1;
+    return next;
+}  /* Next_last_word */
+
+
+/*---------------------------------------------------------------------
+ * Macro:      DEFINE_KERNEL
+ * Purpose:    Define a Life_kernel_t that updates LANES words at a time
+ * In args:    name:  name of the function
+ *             T:  word_t or a GCC vector type with LANES words in it
+ *             attr:  function attributes (e.g., the target ISA)
+ *             B, S:  the rule's birth and survival masks, constants
+ *                for a kernel specialized to the rule, which ignores
+ *                the rule it's called with
+ *
+ * Note:       The kernel reads words first-1 and last of each row, so
+ *             the ghost words must be in place.  Any words left over
+ *             are done with Next_word, and word W-1 with
+ *             Next_last_word.
+ */
+#define DEFINE_KERNEL(name, T, attr, B, S)                                \
+attr static long name(const word_t above[], const word_t row[],           \
+      const word_t below[], word_t out[], int first, int last, int n,     \
+      int birth_arg, int survive_arg) {                                   \
+    const int lanes = sizeof(T)/sizeof(word_t);                           \
+    const int birth = (B), survive = (S);                                 \
+    const int W = (n + WORD_BITS - 1)/WORD_BITS;                          \
+    int hi = last < W ? last : W-1;                                       \
+    int w, k;                                                             \
+    long live = 0;                                                        \
+    T nw, no, ne, we, ctr, ea, sw, so, se, lo, hi_, next;                 \
+    word_t sn, nxt[sizeof(T)/sizeof(word_t)];                             \
+                                                                          \
+    for (w = first; w + lanes <= hi; w += lanes) {                        \
+        memcpy(&lo, above + w - 1, sizeof(T));                            \
+        memcpy(&no, above + w, sizeof(T));                                \
+        memcpy(&hi_, above + w + 1, sizeof(T));                           \
+        nw = (no << 1) | (lo >> (WORD_BITS-1));                           \
+        ne = (no >> 1) | (hi_ << (WORD_BITS-1));                          \
+        memcpy(&lo, row + w - 1, sizeof(T));                              \
+        memcpy(&ctr, row + w, sizeof(T));                                 \
+        memcpy(&hi_, row + w + 1, sizeof(T));                             \
+        we = (ctr << 1) | (lo >> (WORD_BITS-1));                          \
+        ea = (ctr >> 1) | (hi_ << (WORD_BITS-1));                         \
+        memcpy(&lo, below + w - 1, sizeof(T));                            \
+        memcpy(&so, below + w, sizeof(T));                                \
+        memcpy(&hi_, below + w + 1, sizeof(T));                           \
+        sw = (so << 1) | (lo >> (WORD_BITS-1));                           \
+        se = (so >> 1) | (hi_ << (WORD_BITS-1));                          \
+        LIFE_WORD(T, birth, survive, next, nw, no, ne, we, ctr, ea,       \
+              sw, so, se);                                                \
+        memcpy(nxt, &next, sizeof(T));                                    \
+        memcpy(out + w, nxt, sizeof(T));                                  \
+        for (k = 0; k < lanes; k++)                                       \
+            live += __builtin_popcountll(nxt[k]);                         \
+    }                                                                     \
+    for ( ; w < hi; w++) {                                                \
+        sn = Next_word(above, row, below, w, birth, survive);             \
+        out[w] = sn;                                                      \
+        live += __builtin_popcountll(sn);                                 \
+    }                                                                     \
+    if (last == W) {                                                      \
+        sn = Next_last_word(above, row, below, W, n, birth, survive);     \
+        out[W-1] = sn;                                                    \
+        live += __builtin_popcountll(sn);                                 \
+    }                                                                     \
+    (void) birth_arg;                                                     \
+    (void) survive_arg;                                                   \
+    return live;                                                          \
+}
+
+/* DEFINE_KERNELS(rule, B, S) defines a kernel for each instruction set
+ * the compiler can target, and KERNELS(rule) lists them in the order
+ * of kernel_isas
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HAVE_X86_KERNELS
+typedef word_t Vec256_t __attribute__ ((vector_size (32)));
+typedef word_t Vec512_t __attribute__ ((vector_size (64)));
+#define DEFINE_KERNELS(rule, B, S)                                        \
+DEFINE_KERNEL(Kernel_scalar_##rule, word_t, , B, S)                       \
+DEFINE_KERNEL(Kernel_avx2_##rule, Vec256_t,                               \
+      __attribute__ ((target ("avx2,popcnt"))), B, S)                     \
+DEFINE_KERNEL(Kernel_avx512_##rule, Vec512_t,                             \
+      __attribute__ ((target ("avx512f,popcnt"))), B, S)
+#define KERNELS(rule)                                                     \
+    {Kernel_scalar_##rule, Kernel_avx2_##rule, Kernel_avx512_##rule}
+static const char *kernel_isas[] = {"scalar", "avx2", "avx512"};
+#elif defined(__GNUC__) && (defined(__aarch64__) || defined(__ARM_NEON))
+#define HAVE_NEON_KERNEL
+typedef word_t Vec128_t __attribute__ ((vector_size (16)));
+#define DEFINE_KERNELS(rule, B, S)                                        \
+DEFINE_KERNEL(Kernel_scalar_##rule, word_t, , B, S)                       \
+DEFINE_KERNEL(Kernel_neon_##rule, Vec128_t, , B, S)
+#define KERNELS(rule) {Kernel_scalar_##rule, Kernel_neon_##rule}
+static const char *kernel_isas[] = {"scalar", "neon"};
+#else
+#define DEFINE_KERNELS(rule, B, S)                                        \
+DEFINE_KERNEL(Kernel_scalar_##rule, word_t, , B, S)
+#define KERNELS(rule) {Kernel_scalar_##rule}
+static const char *kernel_isas[] = {"scalar"};
+#endif
+
+/* The generic kernels use the rule they're called with */
+DEFINE_KERNELS(generic, birth_arg, survive_arg)
+DEFINE_KERNELS(conway, CONWAY_BIRTH, CONWAY_SURVIVE)
+DEFINE_KERNELS(highlife, 0x048, 0x00C)
+DEFINE_KERNELS(daynight, 0x1C8, 0x1D8)
+DEFINE_KERNELS(seeds, 0x004, 0x000)
+DEFINE_KERNELS(lwod, 0x008, 0x1FF)
+DEFINE_KERNELS(maze, 0x008, 0x03E)
+DEFINE_KERNELS(replicator, 0x0AA, 0x0AA)
+
+/* The rules with kernels of their own, which Life_parse_rule also
+ * takes by name
+ */
+static const Rule_t rules[] = {
+    {"conway", CONWAY_BIRTH, CONWAY_SURVIVE, KERNELS(conway)},  /* B3/S23 */
+    {"highlife", 0x048, 0x00C, KERNELS(highlife)},      /* B36/S23 */
+    {"daynight", 0x1C8, 0x1D8, KERNELS(daynight)},      /* B3678/S34678 */
+    {"seeds", 0x004, 0x000, KERNELS(seeds)},            /* B2/S */
+    {"lwod", 0x008, 0x1FF, KERNELS(lwod)},              /* B3/S012345678 */
+    {"maze", 0x008, 0x03E, KERNELS(maze)},              /* B3/S12345 */
+    {"replicator", 0x0AA, 0x0AA, KERNELS(replicator)},  /* B1357/S1357 */
+};
+#define RULES (sizeof(rules)/sizeof(rules[0]))
+static Life_kernel_t *const generic_kernels[] = KERNELS(generic);
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_create
+ * Purpose:    Make a world of dead cells
+ * In args:    rows, cols:  the world's size
+ *             rule:  in B/S notation, like B36/S23, the name of a rule
+ *                with kernels of its own, or NULL for B3/S23
+ *             backend:  "cpu", or NULL for it
+ * Out arg:    life:  the new world
+ * Ret val:    LIFE_OK, or an error code
+ *
+ * Note:       "cpu" is the only backend (see note 4 in GoL_lib.h);
+ *             any other name is LIFE_EBACKEND.
+ */
+int Life_create(Life_t **life, int rows, int cols, const char rule[],
+      const char backend[]) {
+    Life_t *lp;
+    int birth = CONWAY_BIRTH, survive = CONWAY_SURVIVE, b;
+    size_t words;
+
+    *life = NULL;
+    if (rows < 1 || cols < 1 || rows > LIFE_MAX_SIDE || cols > LIFE_MAX_SIDE)
+        return LIFE_ESIZE;
+    if (rule != NULL && Life_parse_rule(rule, &birth, &survive) != LIFE_OK)
+        return LIFE_ERULE;
+    if (backend != NULL && strcmp(backend, "cpu") != 0)
+        return LIFE_EBACKEND;
+
+    lp = calloc(1, sizeof(Life_t));
+    if (lp == NULL) return LIFE_ENOMEM;
+    lp->m = rows;
+    lp->n = cols;
+    lp->W = (cols + WORD_BITS - 1)/WORD_BITS;
+    lp->pitch = lp->W + 2;
+    lp->birth = birth;
+    lp->survive = survive;
+    lp->kernel = Life_get_kernel(birth, survive, Life_widest_isa(), NULL);
+    words = (size_t) rows*lp->pitch;
+    for (b = 0; b < 2; b++) {
+        lp->buf[b] = calloc(words, sizeof(word_t));
+        lp->changed[b] = calloc(rows, 1);
+    }
+    lp->row_live = calloc(rows, sizeof(long));
+    lp->row_hash = calloc(rows, sizeof(uint64_t));
+    if (lp->buf[0] == NULL || lp->buf[1] == NULL || lp->changed[0] == NULL
+          || lp->changed[1] == NULL || lp->row_live == NULL
+          || lp->row_hash == NULL) {
+        Life_destroy(lp);
+        return LIFE_ENOMEM;
+    }
+
+    Start_world(lp);
+    *life = lp;
+    return LIFE_OK;
+}  /* Life_create */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_destroy
+ * Purpose:    Free everything a world uses
+ * In/out arg: life:  the world, or NULL
+ */
+void Life_destroy(Life_t *life) {
+    int b;
+
+    if (life == NULL) return;
+    for (b = 0; b < 2; b++) {
+        free(life->buf[b]);
+        free(life->changed[b]);
+    }
+    free(life->row_live);
+    free(life->row_hash);
+    free(life);
+}  /* Life_destroy */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_strerror
+ * Purpose:    Describe an error code
+ * In args:    err
+ * Ret val:    A string that mustn't be freed
+ */
+const char *Life_strerror(int err) {
+    switch (err) {
+        case LIFE_OK:       return "no error";
+        case LIFE_ESIZE:    return "bad world size";
+        case LIFE_ERULE:    return "not a rule in B/S notation";
+        case LIFE_EBACKEND: return "no such backend";
+        case LIFE_ENOMEM:   return "out of memory";
+        case LIFE_ERANGE:   return "out of range";
+        default:            return "unknown error";
+    }
+}  /* Life_strerror */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_parse_rule
+ * Purpose:    Get the masks of a rule (see note 19 in GoL.c)
+ * In args:    str:  B<digits>/S<digits>, in which the letters can be
+ *             lower case, or the name of one of the rules in rules
+ * Out args:   birth, survive:  the masks
+ * Ret val:    LIFE_OK, or LIFE_ERULE if str isn't a rule
+ */
+int Life_parse_rule(const char str[], int *birth, int *survive) {
+    int masks[2] = {0, 0}, part;
+    const char *p = str;
+    size_t r;
+
+    for (r = 0; r < RULES; r++)
+        if (strcmp(str, rules[r].name) == 0) {
+            *birth = rules[r].birth;
+            *survive = rules[r].survive;
+            return LIFE_OK;
+        }
+    for (part = 0; part < 2; part++) {
+        if (*p != "BS"[part] && *p != "bs"[part]) return LIFE_ERULE;
+        for (p++; *p >= '0' && *p <= '8'; p++)
+            masks[part] |= 1 << (*p - '0');
+        if (part == 0 && *p++ != '/') return LIFE_ERULE;
+    }
+    if (*p != '\0') return LIFE_ERULE;
+
+    *birth = masks[0];
+    *survive = masks[1];
+    return LIFE_OK;
+}  /* Life_parse_rule */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_clear
+ * Purpose:    Kill every cell and make the world generation 0
+ * In/out arg: life
+ */
+void Life_clear(Life_t *life) {
+    memset(life->buf[life->cur], 0,
+          (size_t) life->m*life->pitch*sizeof(word_t));
+    Start_world(life);
+}  /* Life_clear */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_prob_threshold
+ * Purpose:    Turn the probability that a cell is alive into the
+ *             threshold of Life_seed and Life_seed_row
+ * In args:    prob
+ * Ret val:    prob*2^64, clamped
+ */
+uint64_t Life_prob_threshold(double prob) {
+    if (prob >= 1.0)
+        return UINT64_MAX;
+    else if (prob <= 0.0)
+        return 0;
+    else
+        return prob * 18446744073709551616.0;  /* prob*2^64 */
+}  /* Life_prob_threshold */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_seed_row
+ * Purpose:    Make row i of a random generation 0 (see note 3 in
+ *             GoL_lib.h)
+ * In args:    cols
+ *             i:  the row's number in the whole world
+ *             seed
+ *             threshold:  a cell is alive if its hash is less
+ * Out arg:    row:  its (cols + 63)/64 words
+ *
+ * Note:       Each cell only depends on the seed and its place, so
+ *             the rows can be made in any order, by any thread.
+ */
+void Life_seed_row(uint64_t row[], int cols, uint64_t i, uint64_t seed,
+      uint64_t threshold) {
+    int j, w, last_col;
+    uint64_t key = Life_cell_hash(seed, 0);
+    word_t word;
+
+    for (w = 0; w*WORD_BITS < cols; w++) {
+        word = 0;
+        last_col = (w+1)*WORD_BITS < cols ? (w+1)*WORD_BITS : cols;
+        for (j = w*WORD_BITS; j < last_col; j++)
+            if (Life_cell_hash(key, i*cols + j) < threshold)
+                word |= (word_t) 1 << (j%WORD_BITS);
+        row[w] = word;
+    }
+}  /* Life_seed_row */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_seed
+ * Purpose:    Make generation 0 a random world, the same one GoL.c
+ *             generates for the seed and threshold
+ * In args:    seed
+ *             threshold:  from Life_prob_threshold
+ * In/out arg: life
+ */
+void Life_seed(Life_t *life, uint64_t seed, uint64_t threshold) {
+    int i;
+
+    for (i = 0; i < life->m; i++)
+        Life_seed_row(Row(life, life->cur, i), life->n, i, seed,
+              threshold);
+    Start_world(life);
+}  /* Life_seed */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_parse_text
+ * Purpose:    Find the live cells of a pattern with a line for each
+ *             row and a char for each cell
+ * In args:    text, len:  the pattern.  Lines starting with '!' are
+ *                comments, and a '\r' is ignored.
+ *             rows, cols:  the size of the world
+ *             row, col:  where to put the pattern's top left cell
+ *             live:  the chars that are live cells
+ *             put:  called with arg for each live cell
+ *             arg
+ * Ret val:    LIFE_OK, or LIFE_ERANGE if (row, col) isn't in the world
+ *
+ * Note:       A pattern that runs off the edge of the world wraps
+ *             around.  The row and col are advanced with compares
+ *             rather than taken mod rows and cols for each cell.
+ */
+int Life_parse_text(const char text[], size_t len, int rows, int cols,
+      int row, int col, const char live[], Life_put_t *put, void *arg) {
+    const char *p = text, *end = text + len;
+    int i = row, j;
+
+    if (row < 0 || row >= rows || col < 0 || col >= cols)
+        return LIFE_ERANGE;
+    while (p < end) {
+        if (*p == '!') {
+            p = memchr(p, '\n', end - p);
+            if (p == NULL) break;
+            p++;
+            continue;
+        }
+        j = col;
+        for ( ; p < end && *p != '\n'; p++) {
+            if (*p == '\r') continue;
+            if (strchr(live, *p) != NULL)
+                put(arg, i, j);
+            if (++j == cols) j = 0;
+        }
+        p++;
+        if (++i == rows) i = 0;
+    }
+    return LIFE_OK;
+}  /* Life_parse_text */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_load
+ * Purpose:    Make generation 0 a pattern, and the rest of the world
+ *             dead
+ * In args:    text, len:  the pattern, as for Life_parse_text, in which
+ *             'X' and 'O' are live cells and anything else is dead
+ *             row, col:  where to put the pattern's top left cell
+ * In/out arg: life
+ * Ret val:    LIFE_OK, or LIFE_ERANGE if (row, col) isn't in the world
+ */
+int Life_load(Life_t *life, const char text[], size_t len, int row,
+      int col) {
+    int err;
+
+    if (row < 0 || row >= life->m || col < 0 || col >= life->n)
+        return LIFE_ERANGE;
+    memset(life->buf[life->cur], 0,
+          (size_t) life->m*life->pitch*sizeof(word_t));
+    err = Life_parse_text(text, len, life->m, life->n, row, col, "XO",
+          Put_life_cell, life);
+    Start_world(life);
+    return err;
+}  /* Life_load */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Put_life_cell
+ * Purpose:    Life_load's Life_put_t:  make cell (i, j) of the current
+ *             generation alive, without finishing its row
+ * In args:    arg:  the Life_t
+ *             i, j
+ */
+static void Put_life_cell(void *arg, int i, int j) {
+    Life_t *life = arg;
+
+    Row(life, life->cur, i)[j/WORD_BITS] |= (word_t) 1 << (j%WORD_BITS);
+}  /* Put_life_cell */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_set_cell
+ * Purpose:    Make cell (i, j) of the current generation alive or dead
+ * In args:    i, j
+ *             val:  nonzero for alive
+ * In/out arg: life
+ * Ret val:    LIFE_OK, or LIFE_ERANGE if (i, j) isn't in the world
+ *
+ * Note:       The row is marked as changed, so it and its neighbors
+ *             are recomputed by the next Life_step (see note 2).
+ */
+int Life_set_cell(Life_t *life, int i, int j, int val) {
+    word_t *row, bit = (word_t) 1 << (j%WORD_BITS);
+
+    if (i < 0 || i >= life->m || j < 0 || j >= life->n)
+        return LIFE_ERANGE;
+    row = Row(life, life->cur, i);
+    if (val)
+        row[j/WORD_BITS] |= bit;
+    else
+        row[j/WORD_BITS] &= ~bit;
+
+    life->live -= life->row_live[i];
+    life->hash ^= life->row_hash[i];
+    Finish_row(life, i);
+    life->live += life->row_live[i];
+    life->hash ^= life->row_hash[i];
+    life->changed[life->cur][i] = 1;
+    life->still = 0;
+    return LIFE_OK;
+}  /* Life_set_cell */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_step
+ * Purpose:    Play a number of generations
+ * In args:    gens
+ * In/out arg: life
+ * Ret val:    LIFE_OK, or LIFE_ERANGE if gens < 0
+ */
+int Life_step(Life_t *life, long gens) {
+    if (gens < 0) return LIFE_ERANGE;
+    while (gens > 0 && !life->still) {
+        Next_gen(life);
+        gens--;
+    }
+    /* A still life stays the same */
+    life->gen += gens;
+    return LIFE_OK;
+}  /* Life_step */
+
+
+/*---------------------------------------------------------------------
+ * Functions:  Life_generation, Life_live, Life_hash
+ * Purpose:    Get the number of the current generation, its number of
+ *             live cells, and its hash (see note 3)
+ * In args:    life
+ */
+long Life_generation(const Life_t *life) {
+    return life->gen;
+}  /* Life_generation */
+
+long Life_live(const Life_t *life) {
+    return life->live;
+}  /* Life_live */
+
+uint64_t Life_hash(const Life_t *life) {
+    return life->hash;
+}  /* Life_hash */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_get_cell
+ * Purpose:    Find out whether cell (i, j) of the current generation is
+ *             alive
+ * In args:    life, i, j
+ * Ret val:    1 if it's alive, 0 if it's dead, or LIFE_ERANGE if
+ *             (i, j) isn't in the world
+ */
+int Life_get_cell(const Life_t *life, int i, int j) {
+    if (i < 0 || i >= life->m || j < 0 || j >= life->n)
+        return LIFE_ERANGE;
+    return (Row(life, life->cur, i)[j/WORD_BITS] >> (j%WORD_BITS)) & 1;
+}  /* Life_get_cell */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_cells
+ * Purpose:    Get the current generation without copying it (see note
+ *             2 in GoL_lib.h)
+ * In args:    life
+ * Out arg:    pitch:  words from one row to the next
+ * Ret val:    Word 0 of row 0
+ */
+const uint64_t *Life_cells(const Life_t *life, size_t *pitch) {
+    *pitch = life->pitch;
+    return Row(life, life->cur, 0);
+}  /* Life_cells */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Finish_row
+ * Purpose:    Set the ghost words, live count and hash of row i of the
+ *             current generation from its cells
+ * In args:    i
+ * In/out arg: life
+ */
+static void Finish_row(Life_t *life, int i) {
+    word_t *row = Row(life, life->cur, i);
+    int W = life->W, e = (life->n - 1) % WORD_BITS, w;
+    long live = 0;
+
+    if (e != WORD_BITS-1)
+        row[W-1] &= ((word_t) 2 << e) - 1;
+    row[-1] = ((row[W-1] >> e) & 1) << (WORD_BITS-1);
+    row[W] = row[0] & 1;
+    for (w = 0; w < W; w++)
+        live += __builtin_popcountll(row[w]);
+    life->row_live[i] = live;
+    life->row_hash[i] = Life_row_hash(row, (uint64_t) i*W, 0, W);
+}  /* Finish_row */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Start_world
+ * Purpose:    Make the cells in the current buffer generation 0
+ * In/out arg: life
+ *
+ * Note:       Every row is marked as changed, so the first generation
+ *             recomputes all of them.
+ */
+static void Start_world(Life_t *life) {
+    int i;
+
+    life->gen = 0;
+    life->live = 0;
+    life->hash = 0;
+    life->still = 0;
+    for (i = 0; i < life->m; i++) {
+        Finish_row(life, i);
+        life->live += life->row_live[i];
+        life->hash ^= life->row_hash[i];
+    }
+    memset(life->changed[life->cur], 1, life->m);
+}  /* Start_world */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Next_gen
+ * Purpose:    Play one generation, recomputing only the rows whose
+ *             neighborhoods changed (see note 2)
+ * In/out arg: life
+ */
+static void Next_gen(Life_t *life) {
+    int m = life->m, W = life->W, c = life->cur, i, up, down, w;
+    const unsigned char *changed = life->changed[c];
+    unsigned char *now_changed = life->changed[1-c];
+    word_t *out, diff;
+    long live = 0, rows = 0;
+    uint64_t hash = 0;
+
+    for (i = 0; i < m; i++) {
+        up = i == 0 ? m-1 : i-1;
+        down = i == m-1 ? 0 : i+1;
+        if (Life_active(changed, m, 1, i, 0)) {
+            out = Row(life, 1-c, i);
+            life->row_live[i] = Next_row(life, Row(life, c, up),
+                  Row(life, c, i), Row(life, c, down), out);
+            diff = 0;
+            for (w = 0; w < W; w++)
+                diff |= out[w] ^ Row(life, c, i)[w];
+            now_changed[i] = diff != 0;
+            if (diff != 0) {
+                life->row_hash[i] = Life_row_hash(out, (uint64_t) i*W, 0, W);
+                rows++;
+            }
+        } else {
+            now_changed[i] = 0;
+        }
+        live += life->row_live[i];
+        hash ^= life->row_hash[i];
+    }
+
+    life->cur = 1-c;
+    life->gen++;
+    life->live = live;
+    life->hash = hash;
+    life->still = rows == 0;
+}  /* Next_gen */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Next_row
+ * Purpose:    Compute a row of the next generation, with its ghost
+ *             words
+ * In args:    life
+ *             above, row, below:  rows i-1, i, i+1 of the current gen
+ * Out arg:    out:  row i of the next generation
+ * Ret val:    Number of live cells in it
+ */
+static long Next_row(const Life_t *life, const word_t above[],
+      const word_t row[], const word_t below[], word_t out[]) {
+    int W = life->W, e = (life->n - 1) % WORD_BITS;
+    long live = life->kernel(above, row, below, out, 0, W, life->n,
+          life->birth, life->survive);
+
+    out[-1] = ((out[W-1] >> e) & 1) << (WORD_BITS-1);
+    out[W] = out[0] & 1;
+    return live;
+}  /* Next_row */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_widest_isa
+ * Purpose:    Find the widest kernel the CPU we're running on supports
+ * Ret val:    Its index in kernel_isas
+ */
+int Life_widest_isa(void) {
+    int isa = 0;
+
+#  ifdef HAVE_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        isa = 2;
+    else if (__builtin_cpu_supports("avx2"))
+        isa = 1;
+#  elif defined(HAVE_NEON_KERNEL)
+    isa = 1;
+#  endif
+    return isa;
+}  /* Life_widest_isa */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_isa_name
+ * Purpose:    Name a kernel_isas entry
+ * In args:    isa
+ * Ret val:    Its name, or NULL if there's no such entry
+ */
+const char *Life_isa_name(int isa) {
+    if (isa < 0 || isa > Life_widest_isa()) return NULL;
+    return kernel_isas[isa];
+}  /* Life_isa_name */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_get_kernel
+ * Purpose:    Get the kernel for a rule and an instruction set:  the
+ *             one specialized to the rule if there's one for it, and
+ *             otherwise the generic one
+ * In args:    birth, survive:  the rule
+ *             isa:  index in kernel_isas, <= Life_widest_isa()
+ * Out arg:    generic:  1 if the kernel is the generic one, else 0;
+ *             it can be NULL
+ * Ret val:    The kernel
+ */
+Life_kernel_t *Life_get_kernel(int birth, int survive, int isa,
+      int *generic) {
+    size_t k;
+
+    if (generic != NULL) *generic = 0;
+    for (k = 0; k < RULES; k++)
+        if (rules[k].birth == birth && rules[k].survive == survive)
+            return rules[k].kernel[isa];
+    if (generic != NULL) *generic = 1;
+    return generic_kernels[isa];
+}  /* Life_get_kernel */
+
+
+/*---------------------------------------------------------------------
+ * Function:   Life_active
+ * Purpose:    Decide whether a tile of a world cut into rows x cols
+ *             tiles has to be recomputed
+ * In args:    changed:  changed[i*cols + j] is nonzero if tile (i, j)
+ *             changed in the last generation
+ *             rows, cols
+ *             i, j:  the tile
+ * Ret val:    1 if the tile or one of its neighbors (on the torus of
+ *             tiles) changed in the last generation, 0 otherwise
+ */
+int Life_active(const unsigned char changed[], int rows, int cols, int i,
+      int j) {
+    int di, dj, ni, nj;
+
+    for (di = -1; di <= 1; di++) {
+        ni = i + di < 0 ? rows - 1 : (i + di == rows ? 0 : i + di);
+        for (dj = -1; dj <= 1; dj++) {
+            nj = j + dj < 0 ? cols - 1 : (j + dj == cols ? 0 : j + dj);
+            if (changed[ni*cols + nj]) return 1;
+        }
+    }
+    return 0;
+}  /* Life_active */
@@ -0,0 +1,135 @@
+/* File:     GoL_lib.h
+ * Author:   Ray Wang, 20228436
+ * Purpose:  Interface to the Game of Life library in GoL_lib.c, which
+ *           plays worlds without the command line, stdin or stdout of
+ *           GoL.c, so that they can be played from inside another
+ *           program.
+ *
+ * Notes:
+ * 1.  Everything about a world is in its Life_t, so any number of
+ *     worlds can be played at once, each in one thread at a time.
+ *     Nothing in the library prints or exits:  the functions that can
+ *     fail return LIFE_OK or one of the negative LIFE_E* codes, and
+ *     Life_strerror describes them.
+ * 2.  The world is a torus of rows x cols cells, bit-packed as in
+ *     GoL.c:  row i is Life_cells(life, &pitch) + i*pitch, and column
+ *     j is bit j%64 of word j/64 of it.  Bits past the last column are
+ *     always 0.  The pointer is to the library's own buffer, so it
+ *     only stays valid until the next call that changes the world.
+ * 3.  A world made with Life_seed(life, seed, Life_prob_threshold(prob))
+ *     is the same world as GoL.c generates with -S seed and prob:  cell
+ *     (i, j) is alive if Life_cell_hash of the seed's key and i*cols+j
+ *     is less than the threshold.  The hash of a world XORs together
+ *     the Life_row_hash of each of its rows.
+ * 4.  The only backend is "cpu":  one thread, in the caller's, playing
+ *     the world with the same kernels as GoL.c's cpu engine.  GoL.c's
+ *     threaded tiles, -K, MPI, gpu, hashlife and sparse engines are
+ *     not in the library, since they keep their state in its globals;
+ *     Life_create returns LIFE_EBACKEND for "gpu", "hashlife",
+ *     "sparse", "auto" or any other name.
+ * 5.  Life_kernel_t, Life_get_kernel, Life_widest_isa, Life_isa_name
+ *     and Life_active are the parts of the engine that GoL.c's tiles
+ *     share with Life_step, so that the two can't drift apart.  A
+ *     kernel computes words [first, last) of a row of cols cells from
+ *     the rows above and below, which have the ghost words of note 2
+ *     in GoL_lib.c, and returns the number of live cells in them.
+ * 6.  Life_cell_hash, Life_row_hash, Life_prob_threshold, Life_seed_row
+ *     and Life_parse_text are the hashes, the soups and the text
+ *     loader that GoL.c uses for its own worlds too.  The two hashes
+ *     are defined here, inline, since GoL.c's sparse and HashLife
+ *     engines hash every cell and node they look up.  Life_parse_text
+ *     hands each live cell to a Life_put_t, so that it can fill a
+ *     Life_t or any other kind of world.
+ */
+#ifndef GOL_LIB_H
+#define GOL_LIB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* What the functions that can fail return */
+#define LIFE_OK          0
+#define LIFE_ESIZE      -1      /* rows or cols < 1, or too big */
+#define LIFE_ERULE      -2      /* Not a rule in B/S notation */
+#define LIFE_EBACKEND   -3      /* No such backend in the library */
+#define LIFE_ENOMEM     -4      /* Out of memory */
+#define LIFE_ERANGE     -5      /* A cell or count out of range */
+
+typedef struct Life_s Life_t;
+
+typedef long Life_kernel_t(const uint64_t above[], const uint64_t row[],
+      const uint64_t below[], uint64_t out[], int first, int last,
+      int cols, int birth, int survive);
+
+typedef void Life_put_t(void *arg, int i, int j);
+
+int         Life_create(Life_t **life, int rows, int cols,
+                  const char rule[], const char backend[]);
+void        Life_destroy(Life_t *life);
+const char *Life_strerror(int err);
+int         Life_parse_rule(const char str[], int *birth, int *survive);
+
+void        Life_clear(Life_t *life);
+void        Life_seed(Life_t *life, uint64_t seed, uint64_t threshold);
+int         Life_load(Life_t *life, const char text[], size_t len,
+                  int row, int col);
+uint64_t    Life_prob_threshold(double prob);
+void        Life_seed_row(uint64_t row[], int cols, uint64_t i,
+                  uint64_t seed, uint64_t threshold);
+int         Life_parse_text(const char text[], size_t len, int rows,
+                  int cols, int row, int col, const char live[],
+                  Life_put_t *put, void *arg);
+int         Life_set_cell(Life_t *life, int i, int j, int val);
+
+int         Life_step(Life_t *life, long gens);
+
+long        Life_generation(const Life_t *life);
+long        Life_live(const Life_t *life);
+uint64_t    Life_hash(const Life_t *life);
+int         Life_get_cell(const Life_t *life, int i, int j);
+const uint64_t *Life_cells(const Life_t *life, size_t *pitch);
+
+int         Life_widest_isa(void);
+const char *Life_isa_name(int isa);
+Life_kernel_t *Life_get_kernel(int birth, int survive, int isa,
+                  int *generic);
+int         Life_active(const unsigned char changed[], int rows, int cols,
+                  int i, int j);
+
+/* Counter-based random number generator:  a well mixed 64-bit hash of
+ * a key and a counter.  This is the splitmix64 finalizer applied to
+ * key + ctr*golden ratio.
+ */
+static inline uint64_t Life_cell_hash(uint64_t key, uint64_t ctr) {
+    uint64_t z = key + (ctr + 1) * 0x9E3779B97F4A7C15ULL;
+
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+/* The hash of words [first, last) of a row whose word 0 is word index
+ * of the whole world (i*words per row for row i).  Each nonzero word
+ * adds the hash of its bits and its place, so the hashes of any parts
+ * of a world XOR together into the hash of the whole.
+ */
+static inline uint64_t Life_row_hash(const uint64_t row[], uint64_t index,
+      int first, int last) {
+    uint64_t hash = 0;
+    int w;
+
+    for (w = first; w < last; w++)
+        if (row[w] != 0)
+            hash ^= Life_cell_hash(row[w], index + w);
+    return hash;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif